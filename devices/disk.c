@@ -59,6 +59,7 @@ struct disk {
 
 	long long read_cnt;         /* Number of sectors read. */
 	long long write_cnt;        /* Number of sectors written. */
+	long long cmd_cnt;          /* Number of read and write commands. */
 };
 
 /* An ATA channel (aka controller).
@@ -78,13 +79,16 @@ struct channel {
 
 /* We support the two "legacy" ATA channels found in a standard PC. */
 #define CHANNEL_CNT 2
+
+/* Most sectors one READ or WRITE SECTOR command can transfer. */
+#define MAX_XFER_SECTORS 256
 static struct channel channels[CHANNEL_CNT];
 
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -133,7 +137,7 @@ disk_init (void) {
 			d->is_ata = false;
 			d->capacity = 0;
 
-			d->read_cnt = d->write_cnt = 0;
+			d->read_cnt = d->write_cnt = d->cmd_cnt = 0;
 		}
 
 		/* Register interrupt handler. */
@@ -167,8 +171,8 @@ disk_print_stats (void) {
 		for (dev_no = 0; dev_no < 2; dev_no++) {
 			struct disk *d = disk_get (chan_no, dev_no);
 			if (d != NULL && d->is_ata)
-				printf ("%s: %lld reads, %lld writes\n",
-						d->name, d->read_cnt, d->write_cnt);
+				printf ("%s: %lld reads, %lld writes, %lld commands\n",
+						d->name, d->read_cnt, d->write_cnt, d->cmd_cnt);
 		}
 	}
 }
@@ -209,47 +213,99 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
+	ASSERT (buffer != NULL);
+	disk_readv (d, sec_no, &buffer, 1);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   DISK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+	ASSERT (buffer != NULL);
+	disk_writev (d, sec_no, &buffer, 1);
+}
+
+/* Reads the CNT sectors starting at SEC_NO from disk D, sector
+   SEC_NO + I into SECTORS[I], which must have room for
+   DISK_SECTOR_SIZE bytes.  Runs of up to MAX_XFER_SECTORS sectors
+   take a single command, so this is much cheaper than CNT calls
+   to disk_read().
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_readv (struct disk *d, disk_sector_t sec_no, void *const sectors[],
+		size_t cnt) {
 	struct channel *c;
+	size_t i;
 
 	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
+	ASSERT (sectors != NULL);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
+	for (i = 0; i < cnt; ) {
+		size_t n = cnt - i < MAX_XFER_SECTORS ? cnt - i : MAX_XFER_SECTORS;
+		size_t end = i + n;
+
+		select_sector (d, sec_no + i, n);
+		issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+		/* The disk interrupts once per sector it has ready. */
+		for (; i < end; i++) {
+			ASSERT (sectors[i] != NULL);
+			sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name,
+						sec_no + (disk_sector_t) i);
+			input_sector (c, sectors[i]);
+		}
+		d->read_cnt += n;
+		d->cmd_cnt++;
+	}
 	lock_release (&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   DISK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
+/* Writes the CNT sectors starting at SEC_NO to disk D, sector
+   SEC_NO + I from SECTORS[I], which must contain DISK_SECTOR_SIZE
+   bytes.  Returns after the disk has acknowledged receiving the
+   data.  Runs of up to MAX_XFER_SECTORS sectors take a single
+   command.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 void
-disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+disk_writev (struct disk *d, disk_sector_t sec_no, const void *const sectors[],
+		size_t cnt) {
 	struct channel *c;
+	size_t i;
 
 	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
+	ASSERT (sectors != NULL);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	for (i = 0; i < cnt; ) {
+		size_t n = cnt - i < MAX_XFER_SECTORS ? cnt - i : MAX_XFER_SECTORS;
+		size_t end = i + n;
+
+		select_sector (d, sec_no + i, n);
+		issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+		/* The disk interrupts once it has taken each sector. */
+		for (; i < end; i++) {
+			ASSERT (sectors[i] != NULL);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name,
+						sec_no + (disk_sector_t) i);
+			output_sector (c, sectors[i]);
+			sema_down (&c->completion_wait);
+		}
+		d->write_cnt += n;
+		d->cmd_cnt++;
+	}
 	lock_release (&c->lock);
 }
-
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -402,17 +458,19 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT to the disk's sector selection registers
+   for a transfer of the CNT sectors starting at SEC_NO.  (We use
+   LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt > 0 && cnt <= MAX_XFER_SECTORS);
+	ASSERT (sec_no + cnt <= d->capacity);
+	ASSERT (sec_no + cnt <= (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt % MAX_XFER_SECTORS);  /* 0 means 256. */
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
@@ -2,14 +2,19 @@
 #include <debug.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
+#include "threads/synch.h"
 
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
+/* Threads polling for input. */
+static struct waitq pollers;
+
 /* Initializes the input buffer. */
 void
 input_init (void) {
 	intq_init (&buffer);
+	waitq_init (&pollers);
 }
 
 /* Adds a key to the input buffer.
@@ -21,6 +26,7 @@ input_putc (uint8_t key) {
 
 	intq_putc (&buffer, key);
 	serial_notify ();
+	waitq_wake (&pollers);
 }
 
 /* Retrieves a key from the input buffer.
@@ -46,3 +52,19 @@ input_full (void) {
 	ASSERT (intr_get_level () == INTR_OFF);
 	return intq_full (&buffer);
 }
+
+/* Returns true if a key is waiting in the input buffer.  If ENTRY
+   is non-null, first queues it to be woken when a key arrives. */
+bool
+input_poll (struct waitq_entry *entry) {
+	enum intr_level old_level;
+	bool ready;
+
+	old_level = intr_disable ();
+	if (entry != NULL)
+		waitq_add (&pollers, entry);
+	ready = !intq_empty (&buffer);
+	intr_set_level (old_level);
+
+	return ready;
+}
@@ -20,6 +20,9 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Pending alarms, soonest first. */
+static struct list alarm_list;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -28,6 +31,9 @@ static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static void timer_alarm_fire (void);
+static bool alarm_less (const struct list_elem *, const struct list_elem *,
+		void *);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
@@ -42,6 +48,7 @@ timer_init (void) {
 	outb (0x40, count & 0xff);
 	outb (0x40, count >> 8);
 
+	list_init (&alarm_list);
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -118,6 +125,32 @@ timer_nsleep (int64_t ns) {
 	real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Arms ALARM to up SEMA once the tick count reaches WHEN.  An
+   alarm that is already due fires on the next tick. */
+void
+timer_alarm_set (struct timer_alarm *alarm, int64_t when,
+		struct semaphore *sema) {
+	enum intr_level old_level;
+
+	alarm->when = when;
+	alarm->sema = sema;
+	old_level = intr_disable ();
+	list_insert_ordered (&alarm_list, &alarm->elem, alarm_less, NULL);
+	intr_set_level (old_level);
+}
+
+/* Disarms ALARM.  Must be called before ALARM goes out of scope,
+   whether or not it has fired. */
+void
+timer_alarm_cancel (struct timer_alarm *alarm) {
+	enum intr_level old_level = intr_disable ();
+
+	if (alarm->sema != NULL)
+		list_remove (&alarm->elem);
+	alarm->sema = NULL;
+	intr_set_level (old_level);
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) {
@@ -137,6 +170,7 @@ timer_interrupt (struct intr_frame *args UNUSED) {
 		4. 전역 tick 업데이트 
 	*/
 	thread_awake(ticks);
+	timer_alarm_fire ();
 	if(thread_mlfqs){
 		update_recent_cpu();
 		if(ticks % TIMER_FREQ == 0 ){
@@ -149,6 +183,33 @@ timer_interrupt (struct intr_frame *args UNUSED) {
 	}
 }
 
+/* Fires every alarm that is due.  Called from the timer
+   interrupt. */
+static void
+timer_alarm_fire (void) {
+	while (!list_empty (&alarm_list)) {
+		struct timer_alarm *alarm = list_entry (list_front (&alarm_list),
+				struct timer_alarm, elem);
+		struct semaphore *sema = alarm->sema;
+
+		if (alarm->when > ticks)
+			break;
+		list_pop_front (&alarm_list);
+		alarm->sema = NULL;
+		sema_up (sema);
+	}
+}
+
+/* Orders alarms by the tick they fire at. */
+static bool
+alarm_less (const struct list_elem *a_, const struct list_elem *b_,
+		void *aux UNUSED) {
+	const struct timer_alarm *a = list_entry (a_, struct timer_alarm, elem);
+	const struct timer_alarm *b = list_entry (b_, struct timer_alarm, elem);
+
+	return a->when < b->when;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -2,12 +2,24 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "userprog/pipe.h"
+#ifdef VM
+#include "filesys/page_cache.h"
+#include "threads/vaddr.h"
+#endif
+
+#ifdef VM
+static off_t file_cache_pages (struct file *, void *const pages[], size_t cnt,
+		off_t size, off_t file_ofs, bool write);
+#endif
 
 /* An open file. */
 struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	struct pipe *pipe;          /* Pipe this is an end of, or NULL. */
+	bool pipe_writer;           /* Write end of PIPE? */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -28,6 +40,22 @@ file_open (struct inode *inode) {
 	}
 }
 
+/* Opens an end of PIPE, the write end if WRITER, taking ownership
+ * of one reference to that end.  Returns a null pointer, dropping
+ * the reference, if an allocation fails. */
+struct file *
+file_open_pipe (struct pipe *pipe, bool writer) {
+	struct file *file = calloc (1, sizeof *file);
+	if (file != NULL) {
+		file->pipe = pipe;
+		file->pipe_writer = writer;
+		return file;
+	} else {
+		pipe_close (pipe, writer);
+		return NULL;
+	}
+}
+
 /* Opens and returns a new file for the same inode as FILE.
  * Returns a null pointer if unsuccessful. */
 struct file *
@@ -39,6 +67,11 @@ file_reopen (struct file *file) {
  * same inode as FILE. Returns a null pointer if unsuccessful. */
 struct file *
 file_duplicate (struct file *file) {
+	if (file->pipe != NULL) {
+		pipe_reopen (file->pipe, file->pipe_writer);
+		return file_open_pipe (file->pipe, file->pipe_writer);
+	}
+
 	struct file *nfile = file_open (inode_reopen (file->inode));
 	if (nfile) {
 		nfile->pos = file->pos;
@@ -52,6 +85,8 @@ file_duplicate (struct file *file) {
 void
 file_close (struct file *file) {
 	if (file != NULL) {
+		if (file->pipe != NULL)
+			pipe_close (file->pipe, file->pipe_writer);
 		file_allow_write (file);
 		inode_close (file->inode);
 		free (file);
@@ -64,6 +99,19 @@ file_get_inode (struct file *file) {
 	return file->inode;
 }
 
+/* Returns the pipe FILE is an end of, or a null pointer if FILE is
+ * not a pipe. */
+struct pipe *
+file_get_pipe (struct file *file) {
+	return file->pipe;
+}
+
+/* Returns true if FILE is the write end of a pipe. */
+bool
+file_is_pipe_writer (struct file *file) {
+	return file->pipe != NULL && file->pipe_writer;
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
  * starting at the file's current position.
  * Returns the number of bytes actually read,
@@ -71,7 +119,7 @@ file_get_inode (struct file *file) {
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
-	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+	off_t bytes_read = file_read_at (file, buffer, size, file->pos);
 	file->pos += bytes_read;
 	return bytes_read;
 }
@@ -83,7 +131,27 @@ file_read (struct file *file, void *buffer, off_t size) {
  * The file's current position is unaffected. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
+#ifdef VM
+	return page_cache_read (file->inode, buffer, size, file_ofs);
+#else
 	return inode_read_at (file->inode, buffer, size, file_ofs);
+#endif
+}
+
+/* Reads SIZE bytes from FILE, starting at offset FILE_OFS, which
+ * must be sector-aligned, into the CNT page-sized buffers in PAGES,
+ * laid end to end, with as few disk commands as possible.
+ * Returns the number of bytes actually read,
+ * which may be less than SIZE if end of file is reached.
+ * The file's current position is unaffected. */
+off_t
+file_read_pages_at (struct file *file, void *const pages[], size_t cnt,
+		off_t size, off_t file_ofs) {
+#ifdef VM
+	return file_cache_pages (file, pages, cnt, size, file_ofs, false);
+#else
+	return inode_read_pages (file->inode, pages, cnt, size, file_ofs);
+#endif
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -95,7 +163,7 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) {
-	off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+	off_t bytes_written = file_write_at (file, buffer, size, file->pos);
 	file->pos += bytes_written;
 	return bytes_written;
 }
@@ -110,8 +178,52 @@ file_write (struct file *file, const void *buffer, off_t size) {
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
 		off_t file_ofs) {
+#ifdef VM
+	return page_cache_write (file->inode, buffer, size, file_ofs);
+#else
 	return inode_write_at (file->inode, buffer, size, file_ofs);
+#endif
+}
+
+/* Writes SIZE bytes into FILE, starting at offset FILE_OFS, which
+ * must be sector-aligned, from the CNT page-sized buffers in PAGES,
+ * laid end to end, with as few disk commands as possible.
+ * Returns the number of bytes actually written,
+ * which may be less than SIZE if end of file is reached.
+ * The file's current position is unaffected. */
+off_t
+file_write_pages_at (struct file *file, void *const pages[], size_t cnt,
+		off_t size, off_t file_ofs) {
+#ifdef VM
+	return file_cache_pages (file, pages, cnt, size, file_ofs, true);
+#else
+	return inode_write_pages (file->inode, pages, cnt, size, file_ofs);
+#endif
+}
+
+#ifdef VM
+/* Does the work of file_read_pages_at(), or of
+ * file_write_pages_at() if WRITE, a page at a time through the page
+ * cache, which batches the disk I/O itself. */
+static off_t
+file_cache_pages (struct file *file, void *const pages[], size_t cnt,
+		off_t size, off_t file_ofs, bool write) {
+	off_t done = 0;
+	size_t i;
+
+	for (i = 0; i < cnt && done < size; i++) {
+		off_t chunk = size - done < PGSIZE ? size - done : PGSIZE;
+		off_t n = write
+			? page_cache_write (file->inode, pages[i], chunk, file_ofs + done)
+			: page_cache_read (file->inode, pages[i], chunk, file_ofs + done);
+
+		done += n;
+		if (n < chunk)
+			break;
+	}
+	return done;
 }
+#endif
 
 /* Prevents write operations on FILE's underlying inode
  * until file_allow_write() is called or FILE is closed. */
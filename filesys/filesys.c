@@ -7,6 +7,9 @@
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "devices/disk.h"
+#ifdef VM
+#include "filesys/page_cache.h"
+#endif
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
@@ -45,6 +48,10 @@ filesys_init (bool format) {
  * to disk. */
 void
 filesys_done (void) {
+#ifdef VM
+	/* Files still open keep their dirty pages in the cache. */
+	page_cache_flush ();
+#endif
 	/* Original FS */
 #ifdef EFILESYS
 	fat_close ();
@@ -6,6 +6,13 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "filesys/page_cache.h"
+#endif
+
+static off_t inode_io_pages (struct inode *, void *const pages[], size_t cnt,
+		off_t size, off_t offset, bool write);
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -34,6 +41,9 @@ struct inode {
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
 	struct inode_disk data;             /* Inode content. */
+#ifdef VM
+	struct hash cache;                  /* Cached pages, by offset. */
+#endif
 };
 
 /* Returns the disk sector that contains byte offset POS within
@@ -120,6 +130,12 @@ inode_open (disk_sector_t sector) {
 		return NULL;
 
 	/* Initialize. */
+#ifdef VM
+	if (!hash_init (&inode->cache, page_cache_hash, page_cache_less, NULL)) {
+		free (inode);
+		return NULL;
+	}
+#endif
 	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
@@ -157,6 +173,12 @@ inode_close (struct inode *inode) {
 		/* Remove from inode list and release lock. */
 		list_remove (&inode->elem);
 
+#ifdef VM
+		/* A removed file's data is not worth writing. */
+		page_cache_release (inode, !inode->removed);
+		hash_destroy (&inode->cache, NULL);
+#endif
+
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
 			free_map_release (inode->sector, 1);
@@ -225,6 +247,101 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	return bytes_read;
 }
 
+/* Reads SIZE bytes from INODE, starting at OFFSET, which must be
+ * sector-aligned, into the CNT page-sized buffers in PAGES, laid
+ * end to end.  Each run of whole sectors that are consecutive on
+ * disk is read with one disk command, which is much cheaper than
+ * reading page by page.  Returns the number of bytes actually read,
+ * which may be less than SIZE if end of file is reached. */
+off_t
+inode_read_pages (struct inode *inode, void *const pages[], size_t cnt,
+		off_t size, off_t offset) {
+	return inode_io_pages (inode, pages, cnt, size, offset, false);
+}
+
+/* Writes SIZE bytes into INODE, starting at OFFSET, which must be
+ * sector-aligned, from the CNT page-sized buffers in PAGES, laid
+ * end to end, with one disk command per run of whole sectors that
+ * are consecutive on disk.  Returns the number of bytes actually
+ * written, which may be less than SIZE if end of file is reached
+ * or writes are denied. */
+off_t
+inode_write_pages (struct inode *inode, void *const pages[], size_t cnt,
+		off_t size, off_t offset) {
+	if (inode->deny_write_cnt)
+		return 0;
+	return inode_io_pages (inode, pages, cnt, size, offset, true);
+}
+
+/* Does the work of inode_read_pages(), or of inode_write_pages()
+ * if WRITE. */
+static off_t
+inode_io_pages (struct inode *inode, void *const pages[], size_t cnt,
+		off_t size, off_t offset, bool write) {
+	const size_t per_page = PGSIZE / DISK_SECTOR_SIZE;
+	off_t inode_left = inode_length (inode) - offset;
+	void **sectors;
+	size_t whole, i;
+
+	ASSERT (offset % DISK_SECTOR_SIZE == 0);
+	ASSERT ((size_t) size <= cnt * PGSIZE);
+
+	if (size > inode_left)
+		size = inode_left > 0 ? inode_left : 0;
+	whole = size / DISK_SECTOR_SIZE;
+	sectors = malloc (whole * sizeof *sectors);
+	if (whole > 0 && sectors == NULL) {
+		/* Fall back to a page at a time. */
+		off_t done = 0;
+		for (i = 0; i < cnt && done < size; i++) {
+			off_t chunk = size - done < PGSIZE ? size - done : PGSIZE;
+			done += write
+				? inode_write_at (inode, pages[i], chunk, offset + done)
+				: inode_read_at (inode, pages[i], chunk, offset + done);
+		}
+		return done;
+	}
+
+	for (i = 0; i < whole; i++)
+		sectors[i] = (uint8_t *) pages[i / per_page]
+			+ i % per_page * DISK_SECTOR_SIZE;
+	for (i = 0; i < whole; ) {
+		disk_sector_t first = byte_to_sector (inode, offset + i * DISK_SECTOR_SIZE);
+		size_t n = 1;
+
+		while (i + n < whole
+				&& byte_to_sector (inode, offset + (i + n) * DISK_SECTOR_SIZE)
+				== first + n)
+			n++;
+		if (write)
+			disk_writev (filesys_disk, first, (const void *const *) sectors + i, n);
+		else
+			disk_readv (filesys_disk, first, sectors + i, n);
+		i += n;
+	}
+	free (sectors);
+
+	/* The last sector is only partly in the file. */
+	if (size % DISK_SECTOR_SIZE != 0) {
+		disk_sector_t last = byte_to_sector (inode,
+				offset + whole * DISK_SECTOR_SIZE);
+		uint8_t *data = (uint8_t *) pages[whole / per_page]
+			+ whole % per_page * DISK_SECTOR_SIZE;
+		uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
+
+		if (bounce == NULL)
+			return whole * DISK_SECTOR_SIZE;
+		disk_read (filesys_disk, last, bounce);
+		if (write) {
+			memcpy (bounce, data, size % DISK_SECTOR_SIZE);
+			disk_write (filesys_disk, last, bounce);
+		} else
+			memcpy (data, bounce, size % DISK_SECTOR_SIZE);
+		free (bounce);
+	}
+	return size;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
  * less than SIZE if end of file is reached or an error occurs.
@@ -306,6 +423,20 @@ inode_allow_write (struct inode *inode) {
 	inode->deny_write_cnt--;
 }
 
+/* Returns true if writes to INODE are denied. */
+bool
+inode_write_denied (const struct inode *inode) {
+	return inode->deny_write_cnt > 0;
+}
+
+#ifdef VM
+/* Returns INODE's page cache, a hash of struct page by offset. */
+struct hash *
+inode_cache (struct inode *inode) {
+	return &inode->cache;
+}
+#endif
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode) {
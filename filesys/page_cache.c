@@ -1,6 +1,41 @@
-/* page_cache.c: Implementation of Page Cache (Buffer Cache). */
+/* page_cache.c: Implementation of Page Cache (Buffer Cache).
+ *
+ * Every open inode keeps a hash of the pages of its file that are
+ * in memory, by offset.  read() and write() copy through those
+ * pages, ELF segments and private file mappings are filled from
+ * them, and shared file mappings map the cache frames themselves,
+ * so that every process mapping a file MAP_SHARED sees the same
+ * bytes.
+ *
+ * Cache pages live in ordinary user frames.  The frame holding one
+ * points to its struct page, of type VM_PAGE_CACHE, and lists the
+ * process pages mapping it like any shared frame, so the clock
+ * evicts cache pages along with everything else: page_cache_writeback()
+ * writes a dirty one out and page_cache_destroy() drops it from the
+ * hash.  The hash and the cache pages are protected by frame_lock.
+ *
+ * A miss reads up to PAGE_CACHE_RA pages that are not cached yet
+ * with one batched read, as long as memory is plentiful.  Dirty
+ * pages go out on eviction, on the last close of the inode, and
+ * every WRITEBACK_INTERVAL ticks from kworkerd, which sorts them so
+ * that consecutive ones are written with one batched write.
+ *
+ * kworkerd also reads ranges of files into the cache in the
+ * background for page_cache_prefetch(), as long as memory is
+ * plentiful, so that the faults and reads that follow find them
+ * there. */
 
+#include "filesys/page_cache.h"
+#include <debug.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
 #include "vm/vm.h"
+
+#ifdef VM
 static bool page_cache_readahead (struct page *page, void *kva);
 static bool page_cache_writeback (struct page *page);
 static void page_cache_destroy (struct page *page);
@@ -13,38 +48,587 @@ static const struct page_operations page_cache_op = {
 	.type = VM_PAGE_CACHE,
 };
 
+/* Pages read on a miss, 32 kB, the first one included. */
+#define PAGE_CACHE_RA 8
+
+/* kworkerd writes dirty pages out every WRITEBACK_INTERVAL ticks. */
+#define WRITEBACK_INTERVAL TIMER_FREQ
+
 int page_cache_workerd;
 
+/* A range of a file for kworkerd to read into the cache. */
+struct prefetch {
+	struct inode *inode;        /* Reopened for the request. */
+	off_t start, end;           /* Page-aligned START, END in file. */
+	struct list_elem elem;      /* In prefetch_list. */
+};
+
+/* Requests for kworkerd, protected by frame_lock. */
+static struct list prefetch_list;
+
+/* Upped to wake kworkerd up. */
+static struct semaphore kworkerd_sema;
+
+/* Set once the frame table is up; until then files are read and
+ * written straight from disk. */
+static bool page_cache_ready;
+
+static void page_cache_kworkerd (void *aux);
+static struct page *cache_lookup (struct inode *, off_t offset);
+static struct frame *cache_find (struct inode *, off_t offset);
+static struct frame *cache_get (struct inode *, off_t offset, bool read);
+static struct frame *cache_fill (struct inode *, off_t offset, bool read);
+static void cache_write_out (struct inode *, void *const kvas[], size_t cnt,
+		off_t offset);
+static void cache_write_dirty (struct inode *, off_t start, off_t end);
+static int cache_page_cmp (const void *, const void *);
+static void cache_prefetch (struct prefetch *);
+
 /* The initializer of file vm */
 void
-pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+page_cache_init (void) {
+	page_cache_ready = true;
+	list_init (&prefetch_list);
+	sema_init (&kworkerd_sema, 0);
+	page_cache_workerd = thread_create ("kworkerd", PRI_DEFAULT,
+			page_cache_kworkerd, NULL);
+	if (page_cache_workerd == TID_ERROR)
+		PANIC ("page_cache_init: cannot start kworkerd");
 }
 
 /* Initialize the page cache */
 bool
-page_cache_initializer (struct page *page, enum vm_type type, void *kva) {
+page_cache_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &page_cache_op;
+	return true;
+}
+
+/* Returns a hash of the offset of cache page E. */
+uint64_t
+page_cache_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct page *page = hash_entry (e, struct page, page_cache.elem);
+	return hash_int (page->page_cache.offset / PGSIZE);
+}
+
+/* Orders cache pages A and B of one inode by offset. */
+bool
+page_cache_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct page, page_cache.elem)->page_cache.offset
+		< hash_entry (b, struct page, page_cache.elem)->page_cache.offset;
+}
+
+/* Returns the frame holding the page of INODE at OFFSET, which must
+ * be page-aligned and within the file, pinned, reading it in first
+ * if it is not cached.  Returns a null pointer if memory is
+ * exhausted. */
+struct frame *
+page_cache_get (struct inode *inode, off_t offset) {
+	return cache_get (inode, offset, true);
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at OFFSET,
+ * through the page cache.  Returns the number of bytes actually
+ * read, which may be less than SIZE if end of file is reached. */
+off_t
+page_cache_read (struct inode *inode, void *buffer_, off_t size,
+		off_t offset) {
+	uint8_t *buffer = buffer_;
+	off_t length = inode_length (inode);
+	off_t done = 0;
+
+	if (!page_cache_ready)
+		return inode_read_at (inode, buffer, size, offset);
+	if (size > length - offset)
+		size = length - offset;
+	while (done < size) {
+		off_t pos = offset + done;
+		off_t page_ofs = pos % PGSIZE;
+		off_t chunk = PGSIZE - page_ofs < size - done
+			? PGSIZE - page_ofs : size - done;
+		struct frame *frame = cache_get (inode, pos - page_ofs, true);
+
+		if (frame == NULL)
+			break;
+		/* BUFFER may fault; the frame stays put meanwhile. */
+		memcpy (buffer + done, (uint8_t *) frame->kva + page_ofs, chunk);
+		vm_frame_unpin (frame);
+		done += chunk;
+	}
+	return done;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+ * through the page cache, leaving the pages dirty for writeback.
+ * A page written whole is not read in first.  Returns the number
+ * of bytes actually written, which may be less than SIZE if end of
+ * file is reached or writes are denied. */
+off_t
+page_cache_write (struct inode *inode, const void *buffer_, off_t size,
+		off_t offset) {
+	const uint8_t *buffer = buffer_;
+	off_t length = inode_length (inode);
+	off_t done = 0;
+
+	if (!page_cache_ready)
+		return inode_write_at (inode, buffer, size, offset);
+	if (inode_write_denied (inode))
+		return 0;
+	if (size > length - offset)
+		size = length - offset;
+	while (done < size) {
+		off_t pos = offset + done;
+		off_t page_ofs = pos % PGSIZE;
+		off_t chunk = PGSIZE - page_ofs < size - done
+			? PGSIZE - page_ofs : size - done;
+		bool whole = page_ofs == 0
+			&& (chunk == PGSIZE || pos + chunk == length);
+		struct frame *frame = cache_get (inode, pos - page_ofs, !whole);
+		uint8_t *dst;
+
+		if (frame == NULL)
+			break;
+		/* A shared mapping writes back its own cache frame. */
+		dst = (uint8_t *) frame->kva + page_ofs;
+		if (dst != buffer + done)
+			memcpy (dst, buffer + done, chunk);
+		lock_acquire (&frame_lock);
+		frame->cache->page_cache.dirty = true;
+		lock_release (&frame_lock);
+		vm_frame_unpin (frame);
+		done += chunk;
+	}
+	return done;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+ * into the cached pages the bytes fall in and straight to disk
+ * where they are not cached.  Unlike page_cache_write(), this never
+ * allocates a frame, so the evictor can use it to write back a
+ * private file page.  BUFFER must not fault: it is copied with
+ * frame_lock held.  Returns the number of bytes actually
+ * written. */
+off_t
+page_cache_write_around (struct inode *inode, const void *buffer_,
+		off_t size, off_t offset) {
+	const uint8_t *buffer = buffer_;
+	off_t done = 0;
+
+	if (!page_cache_ready)
+		return inode_write_at (inode, buffer, size, offset);
+	if (inode_write_denied (inode))
+		return 0;
+	while (done < size) {
+		off_t pos = offset + done;
+		off_t page_ofs = pos % PGSIZE;
+		off_t chunk = PGSIZE - page_ofs < size - done
+			? PGSIZE - page_ofs : size - done;
+		struct frame *frame;
+
+		lock_acquire (&frame_lock);
+		frame = cache_find (inode, pos - page_ofs);
+		if (frame != NULL) {
+			memcpy ((uint8_t *) frame->kva + page_ofs, buffer + done, chunk);
+			frame->cache->page_cache.dirty = true;
+			frame->pins--;
+			lock_release (&frame_lock);
+		} else {
+			lock_release (&frame_lock);
+			if (inode_write_at (inode, buffer + done, chunk, pos) != chunk)
+				break;
+		}
+		done += chunk;
+	}
+	return done;
+}
+
+/* Writes the dirty cached pages of INODE in the SIZE bytes from
+ * OFFSET out to disk. */
+void
+page_cache_sync (struct inode *inode, off_t offset, off_t size) {
+	if (page_cache_ready)
+		cache_write_dirty (inode, offset, offset + size);
+}
+
+/* Drops every cached page of INODE, whose last opener is closing
+ * it, after writing the dirty ones out if WRITE_BACK.  Nobody maps
+ * them anymore, since a mapping keeps its file open. */
+void
+page_cache_release (struct inode *inode, bool write_back) {
+	struct hash *cache = inode_cache (inode);
+
+	if (write_back)
+		page_cache_sync (inode, 0, inode_length (inode));
+
+	lock_acquire (&frame_lock);
+	while (!hash_empty (cache)) {
+		struct hash_iterator i;
+		struct page *page;
+		struct frame *frame;
+
+		hash_first (&i, cache);
+		page = hash_entry (hash_next (&i), struct page, page_cache.elem);
+		frame = page->frame;
+		/* Wait for kworkerd or an evictor to be done with it. */
+		if (page->page_cache.loading || frame->evicting || frame->pins > 0) {
+			vm_frame_wait ();
+			continue;
+		}
+		ASSERT (frame->refs == 0);
+		vm_dealloc_page (page);
+		vm_frame_free (frame);
+	}
+	lock_release (&frame_lock);
+}
+
+/* Writes every dirty cached page out to disk, as at shutdown. */
+void
+page_cache_flush (void) {
+	if (page_cache_ready)
+		cache_write_dirty (NULL, 0, 0);
+}
+
+/* Has kworkerd read the SIZE bytes of INODE from OFFSET into the
+ * cache in the background.  Must be called with filesys_lock
+ * held. */
+void
+page_cache_prefetch (struct inode *inode, off_t offset, off_t size) {
+	struct prefetch *p;
+
+	if (!page_cache_ready || size <= 0)
+		return;
+	p = malloc (sizeof *p);
+	if (p == NULL)
+		return;
+	p->inode = inode_reopen (inode);
+	p->start = offset - offset % PGSIZE;
+	p->end = offset + size;
+	lock_acquire (&frame_lock);
+	list_push_back (&prefetch_list, &p->elem);
+	lock_release (&frame_lock);
+	sema_up (&kworkerd_sema);
+}
+
+/* Returns true if the page of INODE at OFFSET is cached and has
+ * been used since the clock last looked at it, rather than just
+ * read ahead, so that mapping it costs no I/O and is likely to pay
+ * off. */
+bool
+page_cache_recent (struct inode *inode, off_t offset) {
+	struct page *page;
+	bool recent;
 
+	if (!page_cache_ready)
+		return false;
+	lock_acquire (&frame_lock);
+	page = cache_lookup (inode, offset);
+	recent = page != NULL && !page->page_cache.loading
+		&& page->page_cache.accessed;
+	lock_release (&frame_lock);
+	return recent;
 }
 
-/* Utilze the Swap in mechanism to implement readhead */
+/* Reads PAGE in from its file into KVA. */
 static bool
 page_cache_readahead (struct page *page, void *kva) {
+	struct page_cache *pc = &page->page_cache;
+	off_t bytes = inode_length (pc->inode) - pc->offset;
+
+	if (bytes > PGSIZE)
+		bytes = PGSIZE;
+	return inode_read_pages (pc->inode, &kva, 1, bytes, pc->offset) == bytes;
 }
 
-/* Utilze the Swap out mechanism to implement writeback */
+/* Writes PAGE, which is being evicted, out to its file if it or a
+ * shared mapping of it was written to. */
 static bool
 page_cache_writeback (struct page *page) {
+	struct page_cache *pc = &page->page_cache;
+
+	if (vm_frame_test_and_clean (page->frame))
+		cache_write_out (pc->inode, &page->frame->kva, 1, pc->offset);
+	return true;
 }
 
-/* Destory the page_cache. */
+/* Removes PAGE from its inode's cache and from its frame.  Must be
+ * called with frame_lock held. */
 static void
 page_cache_destroy (struct page *page) {
+	struct page_cache *pc = &page->page_cache;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	hash_delete (inode_cache (pc->inode), &pc->elem);
+	page->frame->cache = NULL;
+	page->frame = NULL;
 }
 
 /* Worker thread for page cache */
 static void
-page_cache_kworkerd (void *aux) {
+page_cache_kworkerd (void *aux UNUSED) {
+	int64_t writeback = timer_ticks () + WRITEBACK_INTERVAL;
+
+	for (;;) {
+		struct timer_alarm alarm;
+
+		timer_alarm_set (&alarm, writeback, &kworkerd_sema);
+		sema_down (&kworkerd_sema);
+		timer_alarm_cancel (&alarm);
+
+		for (;;) {
+			struct prefetch *p = NULL;
+
+			lock_acquire (&frame_lock);
+			if (!list_empty (&prefetch_list))
+				p = list_entry (list_pop_front (&prefetch_list),
+						struct prefetch, elem);
+			lock_release (&frame_lock);
+			if (p == NULL)
+				break;
+			cache_prefetch (p);
+		}
+		if (timer_ticks () >= writeback) {
+			cache_write_dirty (NULL, 0, 0);
+			writeback = timer_ticks () + WRITEBACK_INTERVAL;
+		}
+	}
+}
+
+/* Reads the range of request P into the cache, while memory is
+ * plentiful, and frees P. */
+static void
+cache_prefetch (struct prefetch *p) {
+	off_t length = inode_length (p->inode);
+	off_t offset;
+
+	for (offset = p->start; offset < p->end && offset < length;
+			offset += PGSIZE) {
+		struct frame *frame;
+
+		if (!vm_frames_plentiful (PAGE_CACHE_RA))
+			break;
+		frame = cache_get (p->inode, offset, true);
+		if (frame == NULL)
+			break;
+		vm_frame_unpin (frame);
+	}
+	lock_acquire (&filesys_lock);
+	inode_close (p->inode);
+	lock_release (&filesys_lock);
+	free (p);
+}
+
+/* Returns the cached page of INODE at OFFSET, or a null pointer if
+ * there is none.  Must be called with frame_lock held. */
+static struct page *
+cache_lookup (struct inode *inode, off_t offset) {
+	struct page key;
+	struct hash_elem *e;
+
+	key.page_cache.offset = offset;
+	e = hash_find (inode_cache (inode), &key.page_cache.elem);
+	return e != NULL ? hash_entry (e, struct page, page_cache.elem) : NULL;
+}
+
+/* Returns the frame of the cached page of INODE at OFFSET, pinned,
+ * once it is neither being read in nor evicted, or a null pointer
+ * if the page is not cached.  Must be called with frame_lock
+ * held. */
+static struct frame *
+cache_find (struct inode *inode, off_t offset) {
+	for (;;) {
+		struct page *page = cache_lookup (inode, offset);
+
+		if (page == NULL)
+			return NULL;
+		if (!page->page_cache.loading && !page->frame->evicting) {
+			page->page_cache.accessed = true;
+			page->frame->pins++;
+			return page->frame;
+		}
+		vm_frame_wait ();
+	}
+}
+
+/* Does the work of page_cache_get().  If READ is false, the caller
+ * is about to overwrite the whole page, so a page that is not
+ * cached is not read in, and nothing is read ahead. */
+static struct frame *
+cache_get (struct inode *inode, off_t offset, bool read) {
+	for (;;) {
+		struct frame *frame;
+
+		lock_acquire (&frame_lock);
+		frame = cache_find (inode, offset);
+		lock_release (&frame_lock);
+		if (frame != NULL)
+			return frame;
+		frame = cache_fill (inode, offset, read);
+		if (frame != (struct frame *) -1)
+			return frame;
+		/* Somebody else cached it meanwhile. */
+	}
+}
+
+/* Caches the page of INODE at OFFSET, and the following pages not
+ * cached yet, up to PAGE_CACHE_RA of them, if READ and memory is
+ * plentiful, reading them in with one batched read if READ.
+ * Returns the frame of the page at OFFSET, pinned, a null pointer
+ * if memory is exhausted, or (struct frame *) -1 if the page got
+ * cached by somebody else first. */
+static struct frame *
+cache_fill (struct inode *inode, off_t offset, bool read) {
+	struct page *pages[PAGE_CACHE_RA];
+	struct frame *frames[PAGE_CACHE_RA];
+	void *kvas[PAGE_CACHE_RA];
+	off_t length = inode_length (inode);
+	size_t want = 1, n, i;
+
+	ASSERT (offset % PGSIZE == 0 && offset < length);
+
+	if (read)
+		while (want < PAGE_CACHE_RA
+				&& offset + (off_t) want * PGSIZE < length
+				&& vm_frames_plentiful (want + 1))
+			want++;
+	for (n = 0; n < want; n++)
+		if ((pages[n] = calloc (1, sizeof *pages[n])) == NULL)
+			break;
+	if (n == 0)
+		return NULL;
+	for (i = 0; i < n; i++) {
+		frames[i] = vm_get_frame ();
+		kvas[i] = frames[i]->kva;
+	}
+
+	/* The frames were allocated without frame_lock, so pages may
+	 * have been cached meanwhile.  The window ends at the first. */
+	lock_acquire (&frame_lock);
+	for (i = 0; i < n; i++) {
+		struct page_cache *pc = &pages[i]->page_cache;
+
+		pc->inode = inode;
+		pc->offset = offset + i * PGSIZE;
+		if (cache_lookup (inode, pc->offset) != NULL)
+			break;
+		page_cache_initializer (pages[i], VM_PAGE_CACHE, kvas[i]);
+		pc->loading = read;
+		pc->accessed = i == 0;
+		hash_insert (inode_cache (inode), &pc->elem);
+		pages[i]->frame = frames[i];
+		frames[i]->cache = pages[i];
+	}
+	for (; n > i; n--) {
+		frames[n - 1]->pins = 0;
+		vm_frame_free (frames[n - 1]);
+		free (pages[n - 1]);
+	}
+	lock_release (&frame_lock);
+	if (n == 0)
+		return (struct frame *) -1;
+	if (!read)
+		return frames[0];
+
+	/* The frames stay pinned while we sleep on the read. */
+	thread_current ()->fault_major = true;
+	if (n == 1)
+		page_cache_readahead (pages[0], kvas[0]);
+	else
+		inode_read_pages (inode, kvas, n,
+				length - offset < (off_t) (n * PGSIZE)
+				? length - offset : (off_t) (n * PGSIZE), offset);
+
+	lock_acquire (&frame_lock);
+	for (i = 0; i < n; i++) {
+		pages[i]->page_cache.loading = false;
+		if (i > 0)
+			frames[i]->pins--;
+	}
+	vm_frame_wake ();
+	lock_release (&frame_lock);
+	return frames[0];
+}
+
+/* Writes the CNT cached pages at KVAS, consecutive pages of INODE
+ * from OFFSET on, out with one batched write. */
+static void
+cache_write_out (struct inode *inode, void *const kvas[], size_t cnt,
+		off_t offset) {
+	off_t bytes = inode_length (inode) - offset;
+
+	if (bytes > (off_t) (cnt * PGSIZE))
+		bytes = cnt * PGSIZE;
+	inode_write_pages (inode, kvas, cnt, bytes, offset);
+	VM_COUNT (NULL, writebacks, cnt);
+}
+
+/* Writes out the dirty cached pages of INODE between START and
+ * END, or of every inode if INODE is null.  They are sorted first
+ * so that each run of consecutive pages goes out with one batched
+ * write. */
+static void
+cache_write_dirty (struct inode *inode, off_t start, off_t end) {
+	struct page **dirty;
+	struct list_elem *e;
+	size_t cnt = 0, i, j, n;
+
+	lock_acquire (&frame_lock);
+	dirty = malloc (list_size (&frame_list) * sizeof *dirty);
+	if (dirty == NULL) {
+		lock_release (&frame_lock);
+		return;
+	}
+	for (e = list_begin (&frame_list); e != list_end (&frame_list);
+			e = list_next (e)) {
+		struct frame *frame = list_entry (e, struct frame, elem);
+		struct page *page = frame->cache;
+
+		if (page == NULL || page->page_cache.loading)
+			continue;
+		if (inode != NULL && (page->page_cache.inode != inode
+					|| page->page_cache.offset + PGSIZE <= start
+					|| page->page_cache.offset >= end))
+			continue;
+		if (vm_frame_is_dirty (frame)) {
+			frame->pins++;
+			dirty[cnt++] = page;
+		}
+	}
+	lock_release (&frame_lock);
+	qsort (dirty, cnt, sizeof *dirty, cache_page_cmp);
+
+	for (i = 0; i < cnt; i += n) {
+		struct page_cache *first = &dirty[i]->page_cache;
+		void *kvas[VM_CLAIM_MAX];
+
+		for (n = 0; i + n < cnt && n < VM_CLAIM_MAX; n++) {
+			struct page_cache *pc = &dirty[i + n]->page_cache;
+
+			if (pc->inode != first->inode
+					|| pc->offset != first->offset + (off_t) (n * PGSIZE))
+				break;
+			/* Writes from here on dirty it again. */
+			vm_frame_test_and_clean (dirty[i + n]->frame);
+			kvas[n] = dirty[i + n]->frame->kva;
+		}
+		cache_write_out (first->inode, kvas, n, first->offset);
+		for (j = 0; j < n; j++)
+			vm_frame_unpin (dirty[i + j]->frame);
+	}
+	free (dirty);
+}
+
+/* Orders pointers to cache pages by inode and offset, for
+ * qsort(). */
+static int
+cache_page_cmp (const void *a_, const void *b_) {
+	const struct page_cache *a = &(*(struct page *const *) a_)->page_cache;
+	const struct page_cache *b = &(*(struct page *const *) b_)->page_cache;
+
+	if (a->inode != b->inode)
+		return a->inode < b->inode ? -1 : 1;
+	return a->offset < b->offset ? -1 : a->offset > b->offset;
 }
+#endif /* VM */
@@ -1,9 +1,12 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
 #include <stdint.h>
 
+struct semaphore;
+
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
@@ -19,6 +22,16 @@ void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+/* A one-shot alarm that ups a semaphore at a given tick. */
+struct timer_alarm {
+	struct list_elem elem;      /* Element in the alarm list. */
+	int64_t when;               /* Tick to fire at. */
+	struct semaphore *sema;     /* Upped when the alarm fires. */
+};
+
+void timer_alarm_set (struct timer_alarm *, int64_t when, struct semaphore *);
+void timer_alarm_cancel (struct timer_alarm *);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
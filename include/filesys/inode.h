@@ -6,6 +6,7 @@
 #include "devices/disk.h"
 
 struct bitmap;
+struct hash;
 
 void inode_init (void);
 bool inode_create (disk_sector_t, off_t);
@@ -15,9 +16,15 @@ disk_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+off_t inode_read_pages (struct inode *, void *const pages[], size_t cnt,
+		off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_write_pages (struct inode *, void *const pages[], size_t cnt,
+		off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
+bool inode_write_denied (const struct inode *);
+struct hash *inode_cache (struct inode *);
 off_t inode_length (const struct inode *);
 
 #endif /* filesys/inode.h */
@@ -1,12 +1,41 @@
 #ifndef FILESYS_PAGE_CACHE_H
 #define FILESYS_PAGE_CACHE_H
-#include "vm/vm.h"
+#include <stdbool.h>
+#include "kernel/hash.h"
+#include "filesys/off_t.h"
 
 struct page;
+struct frame;
+struct inode;
 enum vm_type;
 
-struct page_cache {};
+/* A page of a file held in the page cache.  Its struct page belongs
+ * to no process: the frame holding the data points to it, and
+ * processes that map the file shared add their own pages to that
+ * frame.  Every member is protected by frame_lock. */
+struct page_cache {
+	struct inode *inode;        /* File the page belongs to. */
+	off_t offset;               /* Page-aligned offset in the file. */
+	bool loading;               /* Still being read in? */
+	bool dirty;                 /* Written since last written back? */
+	bool accessed;              /* Used since the clock last looked? */
+	struct hash_elem elem;      /* In the inode's cache. */
+};
 
 void page_cache_init (void);
 bool page_cache_initializer (struct page *page, enum vm_type type, void *kva);
+hash_hash_func page_cache_hash;
+hash_less_func page_cache_less;
+
+struct frame *page_cache_get (struct inode *, off_t offset);
+off_t page_cache_read (struct inode *, void *, off_t size, off_t offset);
+off_t page_cache_write (struct inode *, const void *, off_t size,
+		off_t offset);
+off_t page_cache_write_around (struct inode *, const void *, off_t size,
+		off_t offset);
+void page_cache_sync (struct inode *, off_t offset, off_t size);
+void page_cache_prefetch (struct inode *, off_t offset, off_t size);
+bool page_cache_recent (struct inode *, off_t offset);
+void page_cache_release (struct inode *, bool write_back);
+void page_cache_flush (void);
 #endif
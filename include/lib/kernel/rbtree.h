@@ -0,0 +1,60 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+ *
+ * A balanced binary search tree: insertion, removal, and lookup
+ * take O(log n) time in the number of nodes.
+ *
+ * Like lists and hash tables, the tree does no dynamic allocation.
+ * Each structure that can be in a tree embeds a struct rb_node,
+ * and the rb_entry macro converts a struct rb_node back to the
+ * structure that contains it.  Nodes are ordered by a caller's
+ * rb_less_func.  There is no generic lookup: to search, walk down
+ * from the root through the LEFT and RIGHT members, which is the
+ * only way to search for something other than an equal node, such
+ * as the node whose range contains a key. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree node. */
+struct rb_node {
+	struct rb_node *parent;     /* Null for the root. */
+	struct rb_node *left;       /* Lesser nodes, or null. */
+	struct rb_node *right;      /* Greater or equal nodes, or null. */
+	bool red;                   /* Red or black? */
+};
+
+/* Red-black tree. */
+struct rb_tree {
+	struct rb_node *root;       /* Null if the tree is empty. */
+};
+
+/* Converts pointer to tree node RB_NODE into a pointer to the
+ * structure that RB_NODE is embedded inside.  Supply the name of
+ * the outer structure STRUCT and the member name MEMBER of the
+ * tree node. */
+#define rb_entry(RB_NODE, STRUCT, MEMBER)                       \
+	((STRUCT *) ((uint8_t *) (RB_NODE)                      \
+		- offsetof (STRUCT, MEMBER)))
+
+/* Compares the value of two tree nodes A and B, given auxiliary
+ * data AUX.  Returns true if A is less than B, or false if A is
+ * greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_node *a,
+		const struct rb_node *b, void *aux);
+
+void rb_init (struct rb_tree *);
+bool rb_empty (const struct rb_tree *);
+void rb_insert (struct rb_tree *, struct rb_node *, rb_less_func *, void *aux);
+void rb_remove (struct rb_tree *, struct rb_node *);
+
+/* In-order traversal. */
+struct rb_node *rb_first (const struct rb_tree *);
+struct rb_node *rb_last (const struct rb_tree *);
+struct rb_node *rb_next (const struct rb_node *);
+struct rb_node *rb_prev (const struct rb_node *);
+
+#endif /* lib/kernel/rbtree.h */
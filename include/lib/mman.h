@@ -0,0 +1,62 @@
+#ifndef __LIB_MMAN_H
+#define __LIB_MMAN_H
+
+#include <stddef.h>
+
+/* Flags for mmap(), shared by its callers and the kernel.
+ *
+ * They are passed in mmap()'s WRITABLE argument.  MAP_WRITABLE is
+ * bit 0, so passing plain true or false still works.  A
+ * MAP_ANONYMOUS mapping may pass a null ADDR to let the kernel
+ * pick the address. */
+
+#define MAP_WRITABLE  0x0001    /* Pages may be written. */
+#define MAP_POPULATE  0x0002    /* Read in every page right away. */
+#define MAP_SHARED    0x0004    /* Share pages with other mappers. */
+#define MAP_ANONYMOUS 0x0008    /* Zeros, not a file; FD is ignored. */
+
+/* Flags for msync(); exactly one must be given. */
+#define MS_ASYNC      0x0001    /* Dirty pages go out on their own. */
+#define MS_SYNC       0x0004    /* Write dirty pages before returning. */
+
+/* Advice for madvise().  The access patterns hold for every area
+ * the range touches, as a whole, until other advice replaces them;
+ * WILLNEED and DONTNEED act on just the range, once. */
+#define MADV_NORMAL     0       /* No particular access pattern. */
+#define MADV_RANDOM     1       /* Random access: no fault-around. */
+#define MADV_SEQUENTIAL 2       /* Sequential: read far ahead, drop behind. */
+#define MADV_WILLNEED   3       /* Needed soon: start reading it in. */
+#define MADV_DONTNEED   4       /* Not needed: free its memory now. */
+
+/* Resident set counters of a process, in pages, from rss_stat(). */
+struct rss_stat {
+	size_t rss;                 /* Pages in memory. */
+	size_t limit;               /* Most it may have, or 0 if unlimited. */
+	size_t evicted;             /* Pages evicted to stay under LIMIT. */
+};
+
+/* Buckets of the fault latency histogram.  Bucket I counts faults
+ * served in fewer than 2^(VMSTAT_LAT_SHIFT + I) TSC cycles that no
+ * lower bucket counts, and the last bucket counts the rest. */
+#define VMSTAT_LAT_BUCKETS 16
+#define VMSTAT_LAT_SHIFT 10
+
+/* Virtual memory event counters, from vmstat(), of the whole
+ * system or of one process.  A process counts the faults it took
+ * and the evictions and swap-outs of its pages; page cache pages
+ * and their writebacks count only toward the system. */
+struct vm_stat {
+	long long minor_faults;     /* Faults served from memory. */
+	long long major_faults;     /* Faults that read from disk. */
+	long long stack_faults;     /* Faults that grew the stack. */
+	long long cow_faults;       /* Writes that copied a shared frame. */
+	long long swap_ins;         /* Pages brought back from swap. */
+	long long swap_outs;        /* Pages sent to swap. */
+	long long anon_evictions;   /* Anonymous frames evicted. */
+	long long file_evictions;   /* Private file frames evicted. */
+	long long cache_evictions;  /* Page cache frames evicted. */
+	long long writebacks;       /* Dirty file pages written out. */
+	long long fault_latency[VMSTAT_LAT_BUCKETS];
+};
+
+#endif /* lib/mman.h */
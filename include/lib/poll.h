@@ -0,0 +1,27 @@
+#ifndef __LIB_POLL_H
+#define __LIB_POLL_H
+
+/* Readiness multiplexing, shared by poll() callers and the kernel.
+ *
+ * Each struct pollfd names an object and the events of interest in
+ * EVENTS; poll() fills REVENTS with the events that are ready.
+ * POLLERR, POLLHUP and POLLNVAL are always reported, whether or not
+ * they were asked for. */
+
+/* Events. */
+#define POLLIN    0x0001        /* Data can be read without blocking. */
+#define POLLOUT   0x0004        /* Data can be written without blocking. */
+#define POLLERR   0x0008        /* Write end of a pipe with no readers. */
+#define POLLHUP   0x0010        /* Read end of a pipe with no writers. */
+#define POLLNVAL  0x0020        /* FD is not open, or not a child. */
+#define POLLEXIT  0x0100        /* FD is a child pid, and it exited. */
+
+/* One object to poll. */
+struct pollfd {
+	int fd;                     /* File descriptor, or child pid for
+	                               POLLEXIT. */
+	short events;               /* Requested events. */
+	short revents;              /* Returned events. */
+};
+
+#endif /* lib/poll.h */
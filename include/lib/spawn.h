@@ -0,0 +1,27 @@
+#ifndef __LIB_SPAWN_H
+#define __LIB_SPAWN_H
+
+/* File descriptor actions for spawn().
+ *
+ * The child of spawn() starts with a copy of its parent's file
+ * descriptors.  Before the new program is loaded, the child applies
+ * the actions passed to spawn(), in order, to its own table. */
+
+/* Action types. */
+enum spawn_op {
+	SPAWN_CLOSE,                /* close (fd). */
+	SPAWN_DUP2,                 /* dup2 (fd, newfd). */
+};
+
+/* One action. */
+struct spawn_action {
+	int op;                     /* One of enum spawn_op. */
+	int fd;                     /* Descriptor acted on. */
+	int newfd;                  /* Target descriptor of SPAWN_DUP2. */
+};
+
+/* Maximum number of actions and of arguments passed to spawn(). */
+#define SPAWN_MAX_ACTIONS 16
+#define SPAWN_MAX_ARGS 32
+
+#endif /* lib/spawn.h */
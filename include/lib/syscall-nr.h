@@ -36,6 +36,21 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Batched submission ring. */
+	SYS_URING_SETUP,            /* Register a submission ring. */
+	SYS_URING_ENTER,            /* Consume queued submissions. */
+
+	SYS_PIPE,                   /* Create a pipe. */
+	SYS_POLL,                   /* Wait for readiness on several fds. */
+	SYS_SPAWN,                  /* Start a new process from a file. */
+	SYS_VFORK,                  /* Fork sharing the address space. */
+	SYS_MSYNC,                  /* Write back a memory mapping. */
+	SYS_RSS_LIMIT,              /* Limit the resident set. */
+	SYS_RSS_STAT,               /* Report the resident set. */
+	SYS_SBRK,                   /* Move the end of the heap. */
+	SYS_MADVISE,                /* Advise on the use of memory. */
+	SYS_VMSTAT,                 /* Report virtual memory events. */
 };
 
 #endif /* lib/syscall-nr.h */
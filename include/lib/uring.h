@@ -0,0 +1,113 @@
+#ifndef __LIB_URING_H
+#define __LIB_URING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Batched system call submission ring.
+ *
+ * A process places a `struct uring' followed by its submission
+ * and completion arrays in its own memory and registers it with
+ * uring_setup().  It then fills submission queue entries (SQEs),
+ * advances sq_tail, and rings the doorbell with uring_enter(),
+ * which consumes the whole batch in a single kernel entry and
+ * posts one completion queue entry (CQE) per request.
+ *
+ * Indices are free running and wrap at 2^32; the slot of index I
+ * is I & (entries - 1).  The kernel only writes sq_head and
+ * cq_tail, the process only writes sq_tail and cq_head.
+ *
+ * Memory layout (see URING_SIZE):
+ *   struct uring | struct uring_sqe[entries] | struct uring_cqe[entries] */
+
+/* Maximum number of entries in a ring.  Must be a power of 2. */
+#define URING_MAX_ENTRIES 256
+
+/* Request types. */
+enum uring_op {
+	URING_OP_NOP,               /* Do nothing, complete with 0. */
+	URING_OP_READ,              /* read (fd, addr, len). */
+	URING_OP_WRITE,             /* write (fd, addr, len). */
+	URING_OP_OPEN,              /* open ((char *) addr). */
+	URING_OP_CLOSE,             /* close (fd). */
+	URING_OP_MMAP,              /* mmap (addr, len, flags, fd, off). */
+};
+
+/* Submission queue entry. */
+struct uring_sqe {
+	uint8_t opcode;             /* One of enum uring_op. */
+	uint8_t pad[3];
+	int32_t fd;                 /* File descriptor. */
+	uint64_t addr;              /* Buffer, path or mapping address. */
+	uint64_t len;               /* Buffer or mapping length. */
+	uint64_t off;               /* File offset (mmap). */
+	uint32_t flags;             /* Per-op flags (mmap: writable). */
+	uint32_t pad2;
+	uint64_t user_data;         /* Copied to the completion. */
+};
+
+/* Completion queue entry. */
+struct uring_cqe {
+	uint64_t user_data;         /* From the submission. */
+	int64_t res;                /* Return value of the request. */
+};
+
+/* Ring header shared between a process and the kernel. */
+struct uring {
+	volatile uint32_t sq_head;  /* Next SQE to consume (kernel). */
+	volatile uint32_t sq_tail;  /* Next SQE to fill (process). */
+	volatile uint32_t cq_head;  /* Next CQE to reap (process). */
+	volatile uint32_t cq_tail;  /* Next CQE to post (kernel). */
+	uint32_t entries;           /* Number of SQ and CQ slots. */
+	uint32_t pad;
+};
+
+/* Bytes needed for a ring with ENTRIES slots. */
+#define URING_SIZE(ENTRIES) \
+	(sizeof (struct uring) \
+	 + (ENTRIES) * (sizeof (struct uring_sqe) + sizeof (struct uring_cqe)))
+
+static inline struct uring_sqe *
+uring_sq (struct uring *ring) {
+	return (struct uring_sqe *) (ring + 1);
+}
+
+static inline struct uring_cqe *
+uring_cq (struct uring *ring) {
+	return (struct uring_cqe *) (uring_sq (ring) + ring->entries);
+}
+
+/* Returns the next free SQE of RING, or a null pointer if the
+ * submission queue is full.  The entry is published by
+ * uring_sq_advance(). */
+static inline struct uring_sqe *
+uring_get_sqe (struct uring *ring) {
+	if (ring->sq_tail - ring->sq_head >= ring->entries)
+		return NULL;
+	return &uring_sq (ring)[ring->sq_tail & (ring->entries - 1)];
+}
+
+/* Publishes the SQE returned by the last uring_get_sqe(). */
+static inline void
+uring_sq_advance (struct uring *ring) {
+	asm volatile ("" : : : "memory");
+	ring->sq_tail++;
+}
+
+/* Returns the oldest unreaped CQE of RING, or a null pointer if
+ * there is none.  The entry is released by uring_cq_advance(). */
+static inline struct uring_cqe *
+uring_peek_cqe (struct uring *ring) {
+	if (ring->cq_head == ring->cq_tail)
+		return NULL;
+	return &uring_cq (ring)[ring->cq_head & (ring->entries - 1)];
+}
+
+/* Releases the CQE returned by the last uring_peek_cqe(). */
+static inline void
+uring_cq_advance (struct uring *ring) {
+	asm volatile ("" : : : "memory");
+	ring->cq_head++;
+}
+
+#endif /* lib/uring.h */
@@ -4,6 +4,12 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <mman.h>
+#include <poll.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <syscall-nr.h>
+#include <uring.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -38,9 +44,16 @@ void close (int fd);
 
 int dup2(int oldfd, int newfd);
 
-/* Project 3 and optionally project 4. */
+/* Project 3 and optionally project 4.  WRITABLE takes the MAP_*
+ * flags of <mman.h>. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int msync (void *addr, size_t length, int flags);
+void rss_limit (size_t pages);
+void rss_stat (struct rss_stat *st);
+void *sbrk (intptr_t increment);
+int madvise (void *addr, size_t length, int advice);
+void vmstat (struct vm_stat *st, bool system);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -50,6 +63,36 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* Batched submission ring. */
+int uring_setup (struct uring *ring, unsigned entries);
+int uring_enter (unsigned to_submit);
+
+int pipe (int fds[2]);
+int poll (struct pollfd *fds, unsigned nfds, int timeout);
+
+pid_t spawn (const char *path, char *argv[],
+		const struct spawn_action *actions, unsigned n_actions);
+
+/* Creates a child that shares the caller's memory, including its
+ * stack, and suspends the caller until the child calls exec() or
+ * exit().  Returns 0 in the child.  The child must do nothing but
+ * exec() or exit().
+ *
+ * Always inlined: if the child returned from a vfork() function,
+ * its later calls would overwrite the return address the parent
+ * still has to return through. */
+__attribute__((always_inline))
+static inline pid_t
+vfork (void) {
+	int64_t ret;
+
+	asm volatile ("syscall"
+			: "=a" (ret)
+			: "a" ((uint64_t) SYS_VFORK)
+			: "rcx", "r11", "cc", "memory");
+	return (pid_t) ret;
+}
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
@@ -44,6 +44,24 @@ void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 void sema_up_awake (struct semaphore *sema);
 void sema_down_sleep (struct semaphore *sema);
+
+/* Wait queue. */
+struct waitq {
+	struct list waiters;        /* List of struct waitq_entry. */
+};
+
+/* A waiter's place on a wait queue. */
+struct waitq_entry {
+	struct list_elem elem;      /* Element in the queue's list. */
+	struct waitq *queue;        /* Queue this is on, or NULL. */
+	struct semaphore *sema;     /* Upped on wakeup. */
+};
+
+void waitq_init (struct waitq *);
+void waitq_entry_init (struct waitq_entry *, struct semaphore *);
+void waitq_add (struct waitq *, struct waitq_entry *);
+void waitq_remove (struct waitq_entry *);
+void waitq_wake (struct waitq *);
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
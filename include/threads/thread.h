@@ -2,12 +2,14 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #ifdef VM
 #include "vm/vm.h"
+#include <rbtree.h>
 #endif
 
 
@@ -100,21 +102,30 @@ struct thread {
 	int nice;
 	int32_t recent_cpu;
 	struct file *exec_file;
-	struct semaphore wait_sema;
-	struct semaphore exit_sema;
-	struct semaphore child_load_sema;
-	struct list child_list;
-	struct list_elem child_elem;
 	int exit_status;
 	struct intr_frame parent_if;
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4;                     /* Page map level 4 */
+	struct hash children;               /* Children's exit records. */
+	bool children_ready;                /* Is CHILDREN initialized? */
+	struct exit_record *exit_record;    /* Ours, shared with the parent. */
+	struct uring_ctx *uring;            /* Registered submission ring. */
+	struct thread *vfork_parent;        /* Owner of the borrowed address
+	                                       space, if any. */
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
 	struct hash spt;
+	struct rb_tree vmas;                /* Areas of the address space. */
 	void *stack_bottom;
+	void *heap_start;                   /* Past the highest ELF segment. */
+	void *brk;                          /* End of the heap, from sbrk(). */
+	size_t rss;                         /* Pages resident, under frame_lock. */
+	size_t rss_limit;                   /* Most RSS may be, or 0. */
+	size_t rss_evicted;                 /* Pages evicted to honour it. */
+	struct vm_stat vm_stat;             /* Its VM events, see vmstat(). */
+	bool fault_major;                   /* Has this fault read the disk? */
 #endif
 	/* Owned by thread.c. */
 	struct intr_frame tf;               /* Information for switching */
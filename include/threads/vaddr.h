@@ -31,6 +31,15 @@
 /* Round down to nearest page boundary. */
 #define pg_round_down(va) (void *) ((uint64_t) (va) & ~PGMASK)
 
+/* Huge pages, 2 MB, mapped by one page directory entry. */
+#define HPGBITS 21                         /* Number of offset bits. */
+#define HPGSIZE (1 << HPGBITS)             /* Bytes in a huge page. */
+#define HPGCNT  (HPGSIZE / PGSIZE)         /* Pages in a huge page. */
+#define HPGMASK BITMASK(PGSHIFT, HPGBITS)  /* Huge page offset bits. */
+
+/* Round down to nearest huge page boundary. */
+#define hpg_round_down(va) (void *) ((uint64_t) (va) & ~HPGMASK)
+
 /* Kernel virtual address start */
 #define KERN_BASE LOADER_KERN_BASE
 
@@ -0,0 +1,18 @@
+#ifndef USERPROG_PIPE_H
+#define USERPROG_PIPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct pipe;
+struct waitq_entry;
+
+struct pipe *pipe_create (void);
+void pipe_reopen (struct pipe *, bool writer);
+void pipe_close (struct pipe *, bool writer);
+
+int pipe_read (struct pipe *, void *buffer, size_t size, bool block);
+int pipe_write (struct pipe *, const void *buffer, size_t size);
+short pipe_poll (struct pipe *, bool writer, struct waitq_entry *);
+
+#endif /* userprog/pipe.h */
@@ -0,0 +1,8 @@
+#ifndef USERPROG_POLL_H
+#define USERPROG_POLL_H
+
+#include <poll.h>
+
+int poll (struct pollfd *fds, unsigned nfds, int timeout);
+
+#endif /* userprog/poll.h */
@@ -3,12 +3,17 @@
 
 #include "threads/thread.h"
 
+struct spawn_action;
+
+bool process_add_child (struct thread *child);
 int process_create_initd (const char *file_name);
 int process_fork (const char *name, struct intr_frame *if_);
 int process_exec (void *f_name);
+int process_spawn (char *cmdline, const struct spawn_action *actions,
+		unsigned n_actions);
+int process_vfork (const char *name, const struct intr_frame *if_);
 int process_wait (int);
+short process_poll_child (int, struct waitq_entry *);
 void process_exit (void);
 void process_activate (struct thread *next);
-bool
-lazy_load_segment (struct page *page, void *aux);
 #endif /* userprog/process.h */
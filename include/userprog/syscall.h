@@ -8,7 +8,14 @@
 #include "threads/synch.h"
 typedef int pid_t;
 
+struct spawn_action;
+struct rss_stat;
+struct vm_stat;
+
 void syscall_init (void);
+void check_addr (char *addr);
+void check_page (char *addr);
+void check_buffer (char *buffer, unsigned length, bool writable);
 /* Projects 2 and later. */
 void halt (void); //NO_RETURN
 void exit (int status);// NO_RETURN
@@ -26,9 +33,20 @@ unsigned tell (int fd);
 void close (int fd);
 
 int dup2(int oldfd, int newfd);
+int pipe (int *fds);
+pid_t spawn (const char *path, char **argv,
+		const struct spawn_action *actions, unsigned n_actions);
+pid_t vfork (const struct intr_frame *f);
+struct file *find_file_by_fd (int fd);
 
 /* Project 3 and optionally project 4. */
-void *mmap (void *addr, size_t length, int writable, int fd, unsigned int offset);
+void *mmap (void *addr, size_t length, int flags, int fd, unsigned int offset);
 void munmap (void *addr);
+int msync (void *addr, size_t length, int flags);
+void rss_limit (size_t pages);
+void rss_stat (struct rss_stat *st);
+void *sbrk (intptr_t increment);
+int madvise (void *addr, size_t length, int advice);
+void vmstat (struct vm_stat *st, bool system);
 
 #endif /* userprog/syscall.h */
@@ -0,0 +1,10 @@
+#ifndef USERPROG_URING_H
+#define USERPROG_URING_H
+
+#include <uring.h>
+
+int uring_setup (struct uring *ring, unsigned entries);
+int uring_enter (unsigned to_submit);
+void uring_release (void);
+
+#endif /* userprog/uring.h */
@@ -4,6 +4,8 @@
 struct page;
 enum vm_type;
 #define SECTORS_PER_PAGE (PGSIZE/DISK_SECTOR_SIZE)
+/* Most pages swapped out or read ahead in one disk command. */
+#define SWAP_CLUSTER 8
 
 struct anon_page {
     enum vm_type type;
@@ -12,5 +14,9 @@ struct anon_page {
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void anon_fork (struct page *page);
+bool anon_swap_out_cluster (struct page *pages[], size_t cnt);
+void *do_mmap_anon (void *addr, size_t length, int flags);
+void *do_sbrk (intptr_t increment);
 
 #endif
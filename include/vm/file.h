@@ -15,7 +15,8 @@ struct file_page {
 
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
-void *do_mmap(void *addr, size_t length, int writable,
+void *do_mmap(void *addr, size_t length, int flags,
 		struct file *file, off_t offset);
+int do_msync (void *addr, size_t length, int flags);
 void do_munmap (void *va);
 #endif
@@ -1,6 +1,7 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <mman.h>
 #include "threads/palloc.h"
 #include "kernel/hash.h"
 #include "threads/vaddr.h"
@@ -9,6 +10,9 @@
 #include "lib/round.h"
 #include "threads/synch.h"
 
+/* Lowest address the stack may grow down to. */
+#define STACK_LIMIT (USER_STACK - (1 << 20))
+
 struct list frame_list;
 struct lock frame_lock;
 
@@ -28,6 +32,7 @@ enum vm_type {
 	 * markers, until the value is fit in the int. */
 	IS_STACK = (1 << 3),
 	IS_WRITABLE = (1 << 4),
+	IS_SHARED = (1 << 5),
 
 	/* DO NOT EXCEED THIS VALUE. */
 	VM_MARKER_END = (1 << 31),
@@ -36,16 +41,16 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
-#ifdef EFILESYS
 #include "filesys/page_cache.h"
-#endif
 
 struct page_operations;
 struct thread;
+struct rss_stat;
 // #define IS_WRITABLE(type) (((type) & ~8) & 9)
 // #define IS_STACK(type) (((type) & ~7) & 8)
 #define IS_WRITABLE(type) ((type) & IS_WRITABLE)
 #define IS_STACK(type) ((type) & IS_STACK)
+#define IS_SHARED(type) ((type) & IS_SHARED)
 #define VM_TYPE(type) ((type) & 7)
 
 /* The representation of "page".
@@ -59,28 +64,41 @@ struct page {
 
 	/* Your implementation */
 	struct hash_elem hash_elem;
+	uint64_t *pml4;             /* Page table VA is mapped in. */
+	struct thread *owner;       /* Process whose resident set it is in. */
+	bool writable;              /* May the process write to it? */
+	struct list_elem frame_elem; /* In frame's `pages'. */
+	struct vma *vma;            /* Area the page belongs to. */
+	struct list_elem vma_elem;  /* In the area's `pages'. */
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
 	union {
 		struct uninit_page uninit;
 		struct anon_page anon;
 		struct file_page file;
-#ifdef EFILESYS
 		struct page_cache page_cache;
-#endif
 	};
 };
-struct file_info{
-	struct file *file;
-	size_t bytes;
-	off_t offset;
-	int length;
-};
-/* The representation of "frame" */
+/* The representation of "frame".  After fork, a frame is shared
+ * copy-on-write by the parent's and the child's page, each mapping
+ * it read-only until it writes.  A frame holding a page cache page
+ * is shared writable by the pages of every shared mapping of it,
+ * and stays in the cache when the last of them goes.  Every member
+ * but KVA is protected by frame_lock. */
 struct frame {
 	void *kva;
-	struct page *page;
-	struct list_elem elem;
+	struct list pages;          /* Pages mapping this frame. */
+	int refs;                   /* Number of pages in PAGES. */
+	int pins;                   /* Not to be evicted while nonzero. */
+	bool evicting;              /* Being written out by an evictor? */
+	struct page *cache;         /* Page cache page it holds, or null. */
+	struct list_elem elem;      /* In frame_list. */
+
+	/* Same-page merging. */
+	uint64_t checksum;          /* Contents when ksmd last looked. */
+	bool ksm;                   /* Has ksmd merged pages into it? */
+	bool ksm_hashed;            /* In ksmd's table for this pass? */
+	struct hash_elem ksm_elem;  /* In ksmd's table. */
 };
 
 /* The function table for page operations.
@@ -123,6 +141,47 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+/* Fills the CNT frames at KVAS for vm_claim_pages(). */
+typedef bool vm_fill_func (void *const kvas[], size_t cnt, void *aux);
+#define VM_CLAIM_MAX 16
+bool vm_claim_pages (struct page *pages[], size_t cnt,
+		vm_fill_func *fill, void *aux);
+struct frame *vm_frame_pin (struct page *page);
+struct frame *vm_pin_user_page (void *va, bool write);
+void vm_unpin_user_page (void *va);
+struct frame *vm_frame_lend (void *va);
+bool vm_frame_take (void *va, struct frame *frame);
+void vm_frame_put (struct frame *frame);
+void vm_frame_unpin (struct frame *frame);
+bool vm_frame_test_and_clean (struct frame *frame);
+bool vm_frame_is_dirty (struct frame *frame);
+struct frame *vm_get_frame (void);
+void vm_frame_free (struct frame *frame);
+void vm_frame_wait (void);
+void vm_frame_wake (void);
+bool vm_frames_plentiful (size_t cnt);
+void vm_rss_limit (size_t pages);
+void vm_rss_stat (struct rss_stat *);
+void vm_drop_frame (struct page *page);
+void vm_frame_deactivate (struct page *page);
+void vm_read_stats (struct vm_stat *st, bool system);
+void vm_print_stats (void);
+
+/* System-wide counters of VM events, and a process's share of
+ * them in its struct thread. */
+extern struct vm_stat vm_stats;
+
+/* Adds N to counter FIELD of the system and, if T is not null, of
+ * process T.  Events are counted with all sorts of locks held, and
+ * none, so this turns interrupts off instead of taking one. */
+#define VM_COUNT(T, FIELD, N) do {                                  \
+		struct thread *t_ = (T);                                    \
+		enum intr_level old_level_ = intr_disable ();               \
+		vm_stats.FIELD += (N);                                      \
+		if (t_ != NULL)                                             \
+			t_->vm_stat.FIELD += (N);                               \
+		intr_set_level (old_level_);                                \
+	} while (0)
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
@@ -0,0 +1,57 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <list.h>
+#include <rbtree.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/vm.h"
+
+/* Pages read around a faulting file page, 64 kB, read with a
+ * single disk command. */
+#define FAULT_AROUND_PAGES VM_CLAIM_MAX
+
+/* Pages read ahead of a faulting file page in an area advised
+ * MADV_SEQUENTIAL, in two batched reads.  The same number of pages,
+ * just as far behind, are left for the evictor to take first. */
+#define SEQ_AHEAD_PAGES (2 * FAULT_AROUND_PAGES)
+
+/* A virtual memory area: a page-aligned range of a process's
+ * address space whose pages all come from the same place.  The
+ * struct page for an address in it is only created when the
+ * address is first faulted on. */
+struct vma {
+	void *start;                /* First byte. */
+	void *end;                  /* One past the last byte. */
+	enum vm_type type;          /* Type of its pages, with markers. */
+	bool writable;              /* May the process write to it? */
+	bool mmap;                  /* Created by mmap()? */
+	int advice;                 /* Access pattern, a MADV_* value. */
+	struct file *file;          /* Backing file, owned, or null. */
+	off_t offset;               /* File offset of START. */
+	size_t file_bytes;          /* Bytes from FILE; the rest are zero. */
+	struct list pages;          /* Pages created in it so far. */
+	struct rb_node node;        /* In the address space's tree. */
+};
+
+void vma_init (struct rb_tree *);
+struct vma *vma_create (struct rb_tree *, void *start, size_t length,
+		enum vm_type type, bool writable,
+		struct file *file, off_t offset, size_t file_bytes);
+struct vma *vma_find (const struct rb_tree *, const void *addr);
+bool vma_overlaps (const struct rb_tree *, const void *start, size_t length);
+bool vma_grow_down (struct rb_tree *, struct vma *, void *start);
+bool vma_grow_up (struct rb_tree *, struct vma *, void *end);
+void vma_shrink (struct vma *, void *end);
+void *vma_find_free (const struct rb_tree *, size_t length,
+		void *floor, void *ceiling);
+struct page *vma_get_page (struct vma *, void *va);
+void vma_fault_around (struct vma *, void *addr);
+void vma_populate (struct vma *);
+void vma_sync (struct vma *, void *start, void *end, bool wait);
+void vma_destroy (struct rb_tree *, struct vma *);
+bool vma_copy (struct rb_tree *dst, const struct rb_tree *src);
+void vma_kill (struct rb_tree *);
+int do_madvise (void *addr, size_t length, int advice);
+
+#endif
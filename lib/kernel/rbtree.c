@@ -0,0 +1,290 @@
+/* Red-black tree.
+
+   See rbtree.h for basic information.  The algorithms are the
+   ones in Cormen et al., "Introduction to Algorithms", with null
+   pointers standing in for the black leaves. */
+
+#include "rbtree.h"
+#include "../debug.h"
+
+static void rotate_left (struct rb_tree *, struct rb_node *);
+static void rotate_right (struct rb_tree *, struct rb_node *);
+static void transplant (struct rb_tree *, struct rb_node *old,
+		struct rb_node *new);
+static void remove_fixup (struct rb_tree *, struct rb_node *,
+		struct rb_node *parent);
+static bool is_red (const struct rb_node *);
+
+/* Initializes TREE as an empty tree. */
+void
+rb_init (struct rb_tree *tree) {
+	ASSERT (tree != NULL);
+	tree->root = NULL;
+}
+
+/* Returns true if TREE is empty, false otherwise. */
+bool
+rb_empty (const struct rb_tree *tree) {
+	return tree->root == NULL;
+}
+
+/* Inserts NODE into TREE, ordered by LESS given auxiliary data
+ * AUX.  A node equal to one already in the tree goes after it. */
+void
+rb_insert (struct rb_tree *tree, struct rb_node *node,
+		rb_less_func *less, void *aux) {
+	struct rb_node *parent = NULL;
+	struct rb_node **link = &tree->root;
+
+	ASSERT (tree != NULL);
+	ASSERT (node != NULL);
+
+	while (*link != NULL) {
+		parent = *link;
+		link = less (node, parent, aux) ? &parent->left : &parent->right;
+	}
+	node->parent = parent;
+	node->left = node->right = NULL;
+	node->red = true;
+	*link = node;
+
+	/* Restore the red-black properties: the only violation is
+	 * NODE being red under a red parent. */
+	while (is_red (node->parent)) {
+		struct rb_node *p = node->parent;
+		struct rb_node *g = p->parent;
+		struct rb_node *uncle = p == g->left ? g->right : g->left;
+
+		if (is_red (uncle)) {
+			p->red = uncle->red = false;
+			g->red = true;
+			node = g;
+		} else if (p == g->left) {
+			if (node == p->right) {
+				rotate_left (tree, p);
+				node = p;
+				p = node->parent;
+			}
+			p->red = false;
+			g->red = true;
+			rotate_right (tree, g);
+		} else {
+			if (node == p->left) {
+				rotate_right (tree, p);
+				node = p;
+				p = node->parent;
+			}
+			p->red = false;
+			g->red = true;
+			rotate_left (tree, g);
+		}
+	}
+	tree->root->red = false;
+}
+
+/* Removes NODE, which must be in TREE, from TREE. */
+void
+rb_remove (struct rb_tree *tree, struct rb_node *node) {
+	struct rb_node *child, *parent;
+	bool removed_red;
+
+	ASSERT (tree != NULL);
+	ASSERT (node != NULL);
+
+	if (node->left == NULL || node->right == NULL) {
+		child = node->left != NULL ? node->left : node->right;
+		parent = node->parent;
+		removed_red = node->red;
+		transplant (tree, node, child);
+	} else {
+		/* Put NODE's successor, which has no left child, in its
+		 * place. */
+		struct rb_node *next = node->right;
+
+		while (next->left != NULL)
+			next = next->left;
+		removed_red = next->red;
+		child = next->right;
+		if (next->parent == node)
+			parent = next;
+		else {
+			parent = next->parent;
+			transplant (tree, next, next->right);
+			next->right = node->right;
+			next->right->parent = next;
+		}
+		transplant (tree, node, next);
+		next->left = node->left;
+		next->left->parent = next;
+		next->red = node->red;
+	}
+	if (!removed_red)
+		remove_fixup (tree, child, parent);
+}
+
+/* Returns the least node in TREE, or a null pointer if TREE is
+ * empty. */
+struct rb_node *
+rb_first (const struct rb_tree *tree) {
+	struct rb_node *node = tree->root;
+
+	if (node != NULL)
+		while (node->left != NULL)
+			node = node->left;
+	return node;
+}
+
+/* Returns the greatest node in TREE, or a null pointer if TREE is
+ * empty. */
+struct rb_node *
+rb_last (const struct rb_tree *tree) {
+	struct rb_node *node = tree->root;
+
+	if (node != NULL)
+		while (node->right != NULL)
+			node = node->right;
+	return node;
+}
+
+/* Returns the node after NODE in its tree, or a null pointer if
+ * NODE is the last. */
+struct rb_node *
+rb_next (const struct rb_node *node) {
+	if (node->right != NULL) {
+		node = node->right;
+		while (node->left != NULL)
+			node = node->left;
+		return (struct rb_node *) node;
+	}
+	while (node->parent != NULL && node == node->parent->right)
+		node = node->parent;
+	return node->parent;
+}
+
+/* Returns the node before NODE in its tree, or a null pointer if
+ * NODE is the first. */
+struct rb_node *
+rb_prev (const struct rb_node *node) {
+	if (node->left != NULL) {
+		node = node->left;
+		while (node->right != NULL)
+			node = node->right;
+		return (struct rb_node *) node;
+	}
+	while (node->parent != NULL && node == node->parent->left)
+		node = node->parent;
+	return node->parent;
+}
+
+/* Restores the red-black properties after a black node was
+ * removed from above NODE, which may be null, and whose parent is
+ * now PARENT: every path through NODE is one black node short. */
+static void
+remove_fixup (struct rb_tree *tree, struct rb_node *node,
+		struct rb_node *parent) {
+	while (node != tree->root && !is_red (node)) {
+		if (node == parent->left) {
+			struct rb_node *sibling = parent->right;
+
+			if (is_red (sibling)) {
+				sibling->red = false;
+				parent->red = true;
+				rotate_left (tree, parent);
+				sibling = parent->right;
+			}
+			if (!is_red (sibling->left) && !is_red (sibling->right)) {
+				sibling->red = true;
+				node = parent;
+				parent = node->parent;
+			} else {
+				if (!is_red (sibling->right)) {
+					sibling->left->red = false;
+					sibling->red = true;
+					rotate_right (tree, sibling);
+					sibling = parent->right;
+				}
+				sibling->red = parent->red;
+				parent->red = false;
+				sibling->right->red = false;
+				rotate_left (tree, parent);
+				node = tree->root;
+			}
+		} else {
+			struct rb_node *sibling = parent->left;
+
+			if (is_red (sibling)) {
+				sibling->red = false;
+				parent->red = true;
+				rotate_right (tree, parent);
+				sibling = parent->left;
+			}
+			if (!is_red (sibling->left) && !is_red (sibling->right)) {
+				sibling->red = true;
+				node = parent;
+				parent = node->parent;
+			} else {
+				if (!is_red (sibling->left)) {
+					sibling->right->red = false;
+					sibling->red = true;
+					rotate_left (tree, sibling);
+					sibling = parent->left;
+				}
+				sibling->red = parent->red;
+				parent->red = false;
+				sibling->left->red = false;
+				rotate_right (tree, parent);
+				node = tree->root;
+			}
+		}
+	}
+	if (node != NULL)
+		node->red = false;
+}
+
+/* Makes NODE's right child take its place in TREE, with NODE as
+ * its left child. */
+static void
+rotate_left (struct rb_tree *tree, struct rb_node *node) {
+	struct rb_node *right = node->right;
+
+	node->right = right->left;
+	if (right->left != NULL)
+		right->left->parent = node;
+	transplant (tree, node, right);
+	right->left = node;
+	node->parent = right;
+}
+
+/* Makes NODE's left child take its place in TREE, with NODE as its
+ * right child. */
+static void
+rotate_right (struct rb_tree *tree, struct rb_node *node) {
+	struct rb_node *left = node->left;
+
+	node->left = left->right;
+	if (left->right != NULL)
+		left->right->parent = node;
+	transplant (tree, node, left);
+	left->right = node;
+	node->parent = left;
+}
+
+/* Puts NEW, which may be null, where OLD is in TREE as its
+ * parent's child.  OLD's own children are left alone. */
+static void
+transplant (struct rb_tree *tree, struct rb_node *old, struct rb_node *new) {
+	if (old->parent == NULL)
+		tree->root = new;
+	else if (old == old->parent->left)
+		old->parent->left = new;
+	else
+		old->parent->right = new;
+	if (new != NULL)
+		new->parent = old->parent;
+}
+
+/* Returns true if NODE is red.  Null leaves are black. */
+static bool
+is_red (const struct rb_node *node) {
+	return node != NULL && node->red;
+}
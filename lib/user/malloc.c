@@ -0,0 +1,357 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A size-class malloc() for user programs.
+
+   Each request is rounded up to one of a fixed set of size
+   classes, spaced four to a power of 2 so that no more than about
+   a fifth of a block is wasted.  Every class has a "bin" that
+   keeps the slabs of that class with free blocks in them.  A slab
+   is SLAB_SIZE bytes of anonymous memory obtained with mmap(),
+   starting with a header and divided into blocks of one class.
+   Blocks are carved off the front of a new slab only as they are
+   first needed, so pages of a slab that were never used are never
+   faulted in.  Freed blocks go on their slab's free list.
+
+   Every slab is aligned to SLAB_SIZE, so free() finds the header
+   of a block by rounding its address down.  When the last block
+   of a slab is freed the slab is unmapped and its pages go back
+   to the kernel, except that one empty slab is kept as a spare so
+   that a program freeing and allocating one block over and over
+   does not map and unmap a slab each time.  The spare keeps its
+   mapping but gives its pages back with MADV_DONTNEED, so it costs
+   no memory until it is used again.  Pages of a slab that still
+   has blocks in use are kept, since every one of them holds the
+   start of a block, which a free block needs for its link.
+
+   Requests bigger than the largest class get a mapping of their
+   own, aligned the same way and headed by the same header, which
+   is unmapped as soon as the block is freed.  When realloc()
+   shrinks such a block in place, the whole pages past its new end
+   are given back with MADV_DONTNEED.
+
+   User processes have a single thread, so the bins are simply
+   per process and need no locking. */
+
+#define PGSIZE 4096                     /* Bytes in a page. */
+#define SLAB_SIZE (64 * 1024)           /* Bytes in a slab. */
+#define SLAB_MAGIC 0x5ab1e5ed           /* Detects corrupt slabs. */
+#define ALIGN 16                        /* Alignment of every block. */
+#define LARGE ((unsigned) -1)           /* Class of a big block. */
+
+/* Slab header.  Padded to a multiple of ALIGN. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	unsigned class;             /* Size class, or LARGE. */
+	size_t size;                /* Bytes mapped. */
+	size_t free_cnt;            /* Free blocks, carved or not. */
+	size_t carved;              /* Blocks ever carved off. */
+	struct block *free;         /* Freed blocks. */
+	struct slab *prev, *next;   /* In bin, if it has free blocks. */
+} __attribute__ ((aligned (ALIGN)));
+
+/* Free block. */
+struct block {
+	struct block *next;         /* Next free block in the slab. */
+};
+
+/* Bin. */
+struct bin {
+	size_t block_size;          /* Size of each block in bytes. */
+	size_t blocks_per_slab;     /* Number of blocks in a slab. */
+	struct slab *slabs;         /* Slabs with free blocks. */
+};
+
+/* Block sizes of the classes. */
+static const unsigned short class_sizes[] = {
+	16, 32, 48, 64, 80, 96, 112, 128,
+	160, 192, 224, 256, 320, 384, 448, 512,
+	640, 768, 896, 1024, 1280, 1536, 1792, 2048,
+	2560, 3072, 3584, 4096,
+};
+#define CLASS_CNT (sizeof class_sizes / sizeof *class_sizes)
+#define SMALL_MAX 4096                  /* Biggest class. */
+
+static struct bin bins[CLASS_CNT];
+static unsigned char size_to_class[SMALL_MAX / ALIGN + 1];
+static bool initialized;
+static struct slab *spare;              /* Empty slab kept back. */
+
+static void malloc_init (void);
+static void *map_aligned (size_t size);
+static struct slab *slab_create (struct bin *, unsigned class);
+static void bin_insert (struct bin *, struct slab *);
+static void bin_remove (struct bin *, struct slab *);
+static struct slab *block_to_slab (void *);
+static void large_trim (void *block, size_t size);
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size) {
+	struct bin *bin;
+	struct slab *s;
+	struct block *b;
+
+	/* A null pointer satisfies a request for 0 bytes. */
+	if (size == 0)
+		return NULL;
+	if (!initialized)
+		malloc_init ();
+
+	if (size > SMALL_MAX) {
+		/* SIZE is too big for any class.  Map enough pages to hold
+		   SIZE plus a header. */
+		size_t map_size;
+
+		if (size > SIZE_MAX - sizeof *s - PGSIZE)
+			return NULL;
+		map_size = ROUND_UP (size + sizeof *s, PGSIZE);
+		s = map_aligned (map_size);
+		if (s == NULL)
+			return NULL;
+		s->magic = SLAB_MAGIC;
+		s->class = LARGE;
+		s->size = map_size;
+		return s + 1;
+	}
+
+	bin = &bins[size_to_class[DIV_ROUND_UP (size, ALIGN)]];
+	s = bin->slabs;
+	if (s == NULL) {
+		s = slab_create (bin, bin - bins);
+		if (s == NULL)
+			return NULL;
+		bin_insert (bin, s);
+	}
+
+	/* Reuse a freed block if there is one, otherwise carve a new
+	   one off the untouched part of the slab. */
+	if (s->free != NULL) {
+		b = s->free;
+		s->free = b->next;
+	} else
+		b = (struct block *) ((uint8_t *) (s + 1)
+				+ s->carved++ * bin->block_size);
+	if (--s->free_cnt == 0)
+		bin_remove (bin, s);
+	return b;
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b) {
+	void *p;
+	size_t size;
+
+	/* Calculate block size and make sure it fits in size_t. */
+	if (b != 0 && a > SIZE_MAX / b)
+		return NULL;
+	size = a * b;
+
+	/* Allocate and zero memory.  Big blocks are fresh mappings,
+	   which are zero already. */
+	p = malloc (size);
+	if (p != NULL && size <= SMALL_MAX)
+		memset (p, 0, size);
+
+	return p;
+}
+
+/* Returns the number of bytes allocated for BLOCK. */
+static size_t
+block_size (void *block) {
+	struct slab *s = block_to_slab (block);
+
+	return s->class != LARGE ? bins[s->class].block_size
+		: s->size - sizeof *s;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size) {
+	if (new_size == 0) {
+		free (old_block);
+		return NULL;
+	} else if (old_block == NULL)
+		return malloc (new_size);
+	else {
+		size_t old_size = block_size (old_block);
+		void *new_block;
+
+		/* Stay put if the block is big enough and not more than
+		   twice too big. */
+		if (new_size <= old_size && new_size > old_size / 2) {
+			if (old_size > SMALL_MAX)
+				large_trim (old_block, new_size);
+			return old_block;
+		}
+
+		new_block = malloc (new_size);
+		if (new_block != NULL) {
+			size_t min_size = new_size < old_size ? new_size : old_size;
+			memcpy (new_block, old_block, min_size);
+			free (old_block);
+		}
+		return new_block;
+	}
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p) {
+	struct block *b = p;
+	struct slab *s;
+	struct bin *bin;
+
+	if (p == NULL)
+		return;
+
+	s = block_to_slab (p);
+	if (s->class == LARGE) {
+		munmap (s);
+		return;
+	}
+
+#ifndef NDEBUG
+	/* Clear the block to help detect use-after-free bugs. */
+	memset (b, 0xcc, bins[s->class].block_size);
+#endif
+
+	bin = &bins[s->class];
+	b->next = s->free;
+	s->free = b;
+	if (s->free_cnt++ == 0)
+		bin_insert (bin, s);
+
+	/* Give an empty slab back to the kernel, or keep it as the
+	   spare if there is none.  The spare's pages go back all the
+	   same; slab_create() writes it a new header. */
+	if (s->free_cnt == bin->blocks_per_slab) {
+		bin_remove (bin, s);
+		if (spare == NULL) {
+			madvise (s, SLAB_SIZE, MADV_DONTNEED);
+			spare = s;
+		} else
+			munmap (s);
+	}
+}
+
+/* Gives back the whole pages of big block BLOCK past its first
+   SIZE bytes, which realloc() no longer needs.  They read back as
+   zeros if the block grows into them again. */
+static void
+large_trim (void *block, size_t size) {
+	struct slab *s = block_to_slab (block);
+	uint8_t *keep = (uint8_t *) ROUND_UP ((uintptr_t) block + size, PGSIZE);
+	uint8_t *end = (uint8_t *) s + s->size;
+
+	if (keep < end)
+		madvise (keep, end - keep, MADV_DONTNEED);
+}
+
+/* Initializes the bins and the table of classes by size. */
+static void
+malloc_init (void) {
+	unsigned class = 0;
+	size_t i;
+
+	ASSERT (sizeof (struct slab) % ALIGN == 0);
+	for (i = 0; i < CLASS_CNT; i++) {
+		bins[i].block_size = class_sizes[i];
+		bins[i].blocks_per_slab = (SLAB_SIZE - sizeof (struct slab))
+			/ class_sizes[i];
+	}
+	for (i = 0; i <= SMALL_MAX / ALIGN; i++) {
+		while (class_sizes[class] < i * ALIGN)
+			class++;
+		size_to_class[i] = class;
+	}
+	initialized = true;
+}
+
+/* Maps SIZE bytes of writable anonymous memory at an address
+   aligned to SLAB_SIZE, and returns it, or a null pointer if
+   there is no room.  mmap() only aligns to pages, so this maps
+   enough to be sure of holding an aligned range, then maps that
+   range again on its own. */
+static void *
+map_aligned (size_t size) {
+	uint8_t *p;
+
+	p = mmap (NULL, size + SLAB_SIZE - PGSIZE,
+			MAP_WRITABLE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+	munmap (p);
+	p = (uint8_t *) ROUND_UP ((uintptr_t) p, SLAB_SIZE);
+	return mmap (p, size, MAP_WRITABLE | MAP_ANONYMOUS, -1, 0);
+}
+
+/* Returns an empty slab of CLASS, the spare if there is one, or a
+   null pointer if memory is not available. */
+static struct slab *
+slab_create (struct bin *bin, unsigned class) {
+	struct slab *s = spare;
+
+	if (s != NULL)
+		spare = NULL;
+	else {
+		s = map_aligned (SLAB_SIZE);
+		if (s == NULL)
+			return NULL;
+	}
+	s->magic = SLAB_MAGIC;
+	s->class = class;
+	s->size = SLAB_SIZE;
+	s->free_cnt = bin->blocks_per_slab;
+	s->carved = 0;
+	s->free = NULL;
+	return s;
+}
+
+/* Adds S to the front of BIN's list of slabs with free blocks. */
+static void
+bin_insert (struct bin *bin, struct slab *s) {
+	s->prev = NULL;
+	s->next = bin->slabs;
+	if (bin->slabs != NULL)
+		bin->slabs->prev = s;
+	bin->slabs = s;
+}
+
+/* Removes S from BIN's list of slabs with free blocks. */
+static void
+bin_remove (struct bin *bin, struct slab *s) {
+	if (s->prev != NULL)
+		s->prev->next = s->next;
+	else
+		bin->slabs = s->next;
+	if (s->next != NULL)
+		s->next->prev = s->prev;
+}
+
+/* Returns the slab that block B is in. */
+static struct slab *
+block_to_slab (void *b) {
+	struct slab *s = (struct slab *) ROUND_DOWN ((uintptr_t) b, SLAB_SIZE);
+
+	/* Check that the slab is valid. */
+	ASSERT (s != NULL);
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (s->class == LARGE || s->class < CLASS_CNT);
+
+	return s;
+}
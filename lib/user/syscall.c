@@ -54,7 +54,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			((uint64_t) ARG2), 0, 0, 0))
 
 #define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3) ( \
-		syscall(((uint64_t *) NUMBER), \
+		syscall(((uint64_t) NUMBER), \
 			((uint64_t) ARG0), \
 			((uint64_t) ARG1), \
 			((uint64_t) ARG2), \
@@ -155,6 +155,36 @@ munmap (void *addr) {
 	syscall1 (SYS_MUNMAP, addr);
 }
 
+int
+msync (void *addr, size_t length, int flags) {
+	return syscall3 (SYS_MSYNC, addr, length, flags);
+}
+
+void
+rss_limit (size_t pages) {
+	syscall1 (SYS_RSS_LIMIT, pages);
+}
+
+void
+rss_stat (struct rss_stat *st) {
+	syscall1 (SYS_RSS_STAT, st);
+}
+
+void *
+sbrk (intptr_t increment) {
+	return (void *) syscall1 (SYS_SBRK, increment);
+}
+
+int
+madvise (void *addr, size_t length, int advice) {
+	return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+void
+vmstat (struct vm_stat *st, bool system) {
+	syscall2 (SYS_VMSTAT, st, system);
+}
+
 bool
 chdir (const char *dir) {
 	return syscall1 (SYS_CHDIR, dir);
@@ -194,3 +224,29 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+int
+uring_setup (struct uring *ring, unsigned entries) {
+	return syscall2 (SYS_URING_SETUP, ring, entries);
+}
+
+int
+uring_enter (unsigned to_submit) {
+	return syscall1 (SYS_URING_ENTER, to_submit);
+}
+
+int
+pipe (int fds[2]) {
+	return syscall1 (SYS_PIPE, fds);
+}
+
+int
+poll (struct pollfd *fds, unsigned nfds, int timeout) {
+	return syscall3 (SYS_POLL, fds, nfds, timeout);
+}
+
+pid_t
+spawn (const char *path, char *argv[],
+		const struct spawn_action *actions, unsigned n_actions) {
+	return (pid_t) syscall4 (SYS_SPAWN, path, argv, actions, n_actions);
+}
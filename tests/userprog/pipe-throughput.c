@@ -0,0 +1,112 @@
+/* Streams 512 kB from a child to its parent through a pipe.  The
+   first half goes in page-aligned whole pages, which take the
+   page-handoff path; the second half goes in odd-sized pieces that
+   straddle page buffers.  The parent reads with a mix of sizes and
+   checks that every byte arrives, in order.
+
+   The parent also times each half and prints the rate in cycles per
+   kB, which varies from run to run and is not checked. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define TOTAL (512 * 1024)
+#define ODD 1000
+
+static char buf[4 * PAGE] __attribute__ ((aligned (PAGE)));
+
+static inline unsigned long long
+rdtsc (void)
+{
+  unsigned lo, hi;
+
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((unsigned long long) hi << 32) | lo;
+}
+
+static char
+pattern (size_t ofs)
+{
+  return ofs % 251;
+}
+
+static void
+fill (size_t ofs, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    buf[i] = pattern (ofs + i);
+}
+
+static void
+writer (int fd)
+{
+  size_t ofs = 0;
+
+  while (ofs < TOTAL / 2)
+    {
+      fill (ofs, sizeof buf);
+      if (write (fd, buf, sizeof buf) != sizeof buf)
+        fail ("short write at %zu", ofs);
+      ofs += sizeof buf;
+    }
+  while (ofs < TOTAL)
+    {
+      size_t size = TOTAL - ofs < ODD ? TOTAL - ofs : ODD;
+
+      fill (ofs, size);
+      if (write (fd, buf + 1, 0) != 0 || write (fd, buf, size) != (int) size)
+        fail ("short write at %zu", ofs);
+      ofs += size;
+    }
+}
+
+void
+test_main (void)
+{
+  unsigned long long start, half = 0, end;
+  size_t ofs = 0;
+  size_t reads = 0;
+  int fds[2];
+  int pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  if ((pid = fork ("child")) == 0)
+    {
+      close (fds[0]);
+      writer (fds[1]);
+      exit (0);
+    }
+
+  close (fds[1]);
+  start = rdtsc ();
+  for (;;)
+    {
+      size_t size = reads++ % 2 ? sizeof buf : 777;
+      int n = read (fds[0], buf, size);
+      int i;
+
+      if (n < 0)
+        fail ("read failed at %zu", ofs);
+      if (n == 0)
+        break;
+      for (i = 0; i < n; i++)
+        if (buf[i] != pattern (ofs + i))
+          fail ("byte %zu is %d, expected %d",
+                ofs + i, buf[i], pattern (ofs + i));
+      ofs += n;
+      if (half == 0 && ofs >= TOTAL / 2)
+        half = rdtsc ();
+    }
+  end = rdtsc ();
+  msg ("received %zu bytes", ofs);
+  msg ("bench: whole pages: %llu cycles per kB",
+       (half - start) / (TOTAL / 2 / 1024));
+  msg ("bench: odd pieces: %llu cycles per kB",
+       (end - half) / (TOTAL / 2 / 1024));
+  msg ("child exit status is %d", wait (pid));
+  close (fds[0]);
+}
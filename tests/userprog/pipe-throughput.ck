@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/^\(pipe-throughput\) bench: /, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(pipe-throughput) begin
+(pipe-throughput) pipe
+child: exit(0)
+(pipe-throughput) received 524288 bytes
+(pipe-throughput) child exit status is 0
+(pipe-throughput) end
+pipe-throughput: exit(0)
+EOF
+pass;
@@ -0,0 +1,60 @@
+/* Polls a pipe, the console and a child process.  Checks that an
+   empty pipe is not readable, that a timeout expires, and that a
+   blocked poll wakes up when the child writes and when it exits. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  struct pollfd pfds[2];
+  char buf[8];
+  int fds[2];
+  int pid;
+  int n, m;
+
+  CHECK (pipe (fds) == 0, "pipe");
+
+  pfds[0].fd = fds[0];
+  pfds[0].events = POLLIN;
+  pfds[1].fd = fds[1];
+  pfds[1].events = POLLOUT;
+  CHECK (poll (pfds, 2, 0) == 1 && pfds[0].revents == 0
+         && pfds[1].revents == POLLOUT, "poll empty pipe");
+
+  pfds[0].fd = 1;
+  pfds[0].events = POLLOUT;
+  pfds[1].fd = 1234;
+  pfds[1].events = POLLIN;
+  CHECK (poll (pfds, 2, 0) == 2 && pfds[0].revents == POLLOUT
+         && pfds[1].revents == POLLNVAL, "poll stdout and a bad fd");
+
+  pfds[0].fd = fds[0];
+  pfds[0].events = POLLIN;
+  CHECK (poll (pfds, 1, 30) == 0 && pfds[0].revents == 0,
+         "poll times out");
+
+  if ((pid = fork ("child")) == 0)
+    {
+      close (fds[0]);
+      write (fds[1], "ping", 4);
+      exit (0);
+    }
+  close (fds[1]);
+
+  /* Print nothing until the child is gone, so that its exit
+     message lands in a fixed place. */
+  n = poll (pfds, 1, -1);
+  m = read (fds[0], buf, sizeof buf);
+  pfds[0].fd = pid;
+  pfds[0].events = POLLEXIT;
+  CHECK (poll (pfds, 1, -1) == 1 && pfds[0].revents == POLLEXIT,
+         "poll child exit");
+  CHECK (n == 1, "pipe became readable");
+  CHECK (m == 4 && !memcmp (buf, "ping", 4), "read \"ping\"");
+  CHECK (wait (pid) == 0, "wait for child");
+  close (fds[0]);
+}
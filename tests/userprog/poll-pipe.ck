@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(poll-pipe) begin
+(poll-pipe) pipe
+(poll-pipe) poll empty pipe
+(poll-pipe) poll stdout and a bad fd
+(poll-pipe) poll times out
+child: exit(0)
+(poll-pipe) poll child exit
+(poll-pipe) pipe became readable
+(poll-pipe) read "ping"
+(poll-pipe) wait for child
+(poll-pipe) end
+poll-pipe: exit(0)
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Spawns child-simple with its stdout redirected into a pipe, and
+   reads back what it printed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  static const char expected[] = "(child-simple) run\n";
+  char *argv[] = {"child-simple", "unused", NULL};
+  struct spawn_action actions[2];
+  char buf[64];
+  size_t ofs = 0;
+  int fds[2];
+  int pid, n;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  actions[0].op = SPAWN_DUP2;
+  actions[0].fd = fds[1];
+  actions[0].newfd = 1;
+  actions[1].op = SPAWN_CLOSE;
+  actions[1].fd = fds[0];
+  CHECK ((pid = spawn ("child-simple", argv, actions, 2)) > 0,
+         "spawn child-simple");
+  close (fds[1]);
+
+  while ((n = read (fds[0], buf + ofs, sizeof buf - 1 - ofs)) > 0)
+    ofs += n;
+  buf[ofs] = '\0';
+  CHECK (!strcmp (buf, expected), "child wrote \"%.*s\" to the pipe",
+         (int) strlen (expected) - 1, expected);
+  CHECK (wait (pid) == 81, "wait for child");
+}
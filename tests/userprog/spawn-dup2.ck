@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-dup2) begin
+(spawn-dup2) pipe
+(spawn-dup2) spawn child-simple
+child-simple: exit(81)
+(spawn-dup2) child wrote "(child-simple) run" to the pipe
+(spawn-dup2) wait for child
+(spawn-dup2) end
+spawn-dup2: exit(0)
+EOF
+pass;
@@ -0,0 +1,82 @@
+/* Registers a submission ring, then opens, writes, reads back and
+   closes a file with two doorbells instead of eight system
+   calls. */
+
+#include <string.h>
+#include <syscall.h>
+#include <uring.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ENTRIES 8
+
+static uint64_t ring_buf[URING_SIZE (ENTRIES) / sizeof (uint64_t) + 1];
+static const char text[] = "batched by the ring";
+
+static void
+queue (struct uring *ring, int opcode, int fd, const void *addr,
+       size_t len, uint64_t tag)
+{
+  struct uring_sqe *sqe = uring_get_sqe (ring);
+
+  if (sqe == NULL)
+    fail ("submission queue full");
+  memset (sqe, 0, sizeof *sqe);
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) addr;
+  sqe->len = len;
+  sqe->user_data = tag;
+  uring_sq_advance (ring);
+}
+
+static int64_t
+reap (struct uring *ring, uint64_t tag)
+{
+  struct uring_cqe *cqe = uring_peek_cqe (ring);
+  int64_t res;
+
+  if (cqe == NULL)
+    fail ("missing completion %d", (int) tag);
+  if (cqe->user_data != tag)
+    fail ("completion %d arrived out of order", (int) tag);
+  res = cqe->res;
+  uring_cq_advance (ring);
+  return res;
+}
+
+void
+test_main (void)
+{
+  struct uring *ring = (struct uring *) ring_buf;
+  char buf[sizeof text];
+  int wfd, rfd;
+
+  CHECK (create ("ring.txt", 0), "create \"ring.txt\"");
+  CHECK (uring_setup (ring, ENTRIES) == 0, "uring_setup");
+
+  queue (ring, URING_OP_OPEN, 0, "ring.txt", 0, 1);
+  queue (ring, URING_OP_OPEN, 0, "ring.txt", 0, 2);
+  CHECK (uring_enter (2) == 2, "submit 2 opens");
+  wfd = reap (ring, 1);
+  rfd = reap (ring, 2);
+  if (wfd < 2 || rfd < 2 || wfd == rfd)
+    fail ("open returned fds %d and %d", wfd, rfd);
+
+  memset (buf, 0, sizeof buf);
+  queue (ring, URING_OP_WRITE, wfd, text, sizeof text, 3);
+  queue (ring, URING_OP_READ, rfd, buf, sizeof buf, 4);
+  queue (ring, URING_OP_CLOSE, wfd, NULL, 0, 5);
+  queue (ring, URING_OP_CLOSE, rfd, NULL, 0, 6);
+  CHECK (uring_enter (4) == 4, "submit write, read and 2 closes");
+  if (reap (ring, 3) != sizeof text)
+    fail ("short write");
+  if (reap (ring, 4) != sizeof text)
+    fail ("short read");
+  reap (ring, 5);
+  reap (ring, 6);
+  if (memcmp (buf, text, sizeof text))
+    fail ("read back \"%s\" instead of \"%s\"", buf, text);
+
+  CHECK (uring_enter (1) == 0, "empty ring consumes nothing");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(uring-batch) begin
+(uring-batch) create "ring.txt"
+(uring-batch) uring_setup
+(uring-batch) submit 2 opens
+(uring-batch) submit write, read and 2 closes
+(uring-batch) empty ring consumes nothing
+(uring-batch) end
+uring-batch: exit(0)
+EOF
+pass;
@@ -0,0 +1,30 @@
+/* Creates a child with vfork(), which writes to memory it shares
+   with its parent and then execs child-simple.  The parent must
+   see the write and must not run until the exec. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static volatile int shared;
+
+void
+test_main (void)
+{
+  int pid, seen, status;
+
+  pid = vfork ();
+  if (pid == 0)
+    {
+      shared = 1;
+      exec ("child-simple");
+      exit (-1);
+    }
+
+  /* The child is now loading: print nothing until it is gone. */
+  seen = shared;
+  status = wait (pid);
+  CHECK (pid > 0, "vfork");
+  CHECK (seen == 1, "child's write is visible");
+  CHECK (status == 81, "wait for child");
+}
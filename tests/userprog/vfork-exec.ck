@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vfork-exec) begin
+(child-simple) run
+vfork-exec: exit(81)
+(vfork-exec) vfork
+(vfork-exec) child's write is visible
+(vfork-exec) wait for child
+(vfork-exec) end
+vfork-exec: exit(0)
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Forks far more children than the kernel could keep as threads
+   waiting to be reaped, one at a time, and only waits for them
+   after all have exited, in reverse order.  An exited child's
+   thread and page tables must be freed at once, or forking runs
+   out of memory part way; each child's exit status must still be
+   there, and waiting twice must fail. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Each lingering child would hold at least its thread page and its
+   page tables, several kernel pages in all, and the kernel pool of
+   a 20 MB machine has fewer than 2,560 pages. */
+#define CHILDREN 1000
+
+static int pids[CHILDREN];
+
+void
+test_main (void)
+{
+  int fds[2];
+  char c;
+  int i;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  for (i = 0; i < CHILDREN; i++)
+    {
+      pids[i] = fork ("child");
+      if (pids[i] == 0)
+        {
+          write (fds[1], "x", 1);
+          exit (i);
+        }
+      if (pids[i] < 0)
+        fail ("fork %d failed", i);
+
+      /* Let the child get as far as exiting before the next one. */
+      if (read (fds[0], &c, 1) != 1)
+        fail ("child %d did not check in", i);
+    }
+  msg ("forked %d children", CHILDREN);
+
+  for (i = CHILDREN - 1; i >= 0; i--)
+    if (wait (pids[i]) != i)
+      fail ("child %d returned the wrong status", i);
+  msg ("waited for %d children", CHILDREN);
+  CHECK (wait (pids[0]) == -1, "wait twice");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(wait-late) begin
+(wait-late) pipe
+(wait-late) forked 1000 children
+(wait-late) waited for 1000 children
+(wait-late) wait twice
+(wait-late) end
+EOF
+pass;
@@ -0,0 +1,117 @@
+/* Fills a huge-page-aligned anonymous mapping, which has to end up
+   in physically contiguous, huge-page-aligned memory, and then
+   splits the huge page every way the kernel can: by forking and
+   writing, by dropping half of it with MADV_DONTNEED, and by
+   evicting it to stay under a resident set limit.  The contents
+   must come through each split, and the range must be promoted
+   again after the first two. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BASE ((char *) 0x20000000)
+#define HUGE (2 * 1024 * 1024)
+#define PAGE 4096
+#define PAGES (HUGE / PAGE)
+#define SCRATCH (BASE + HUGE)
+
+/* Fills page I of the mapping with a byte that depends on SALT. */
+static void
+fill (size_t i, int salt)
+{
+  memset (BASE + i * PAGE, (int) (i % 251) + salt, PAGE);
+}
+
+/* Checks that page I holds what fill (I, SALT) put there, or zeros
+   if SALT is -1. */
+static void
+check (size_t i, int salt)
+{
+  char want = salt < 0 ? 0 : (char) ((i % 251) + salt);
+  size_t j;
+
+  for (j = 0; j < PAGE; j++)
+    if (BASE[i * PAGE + j] != want)
+      fail ("byte %zu of page %zu is %d, not %d",
+            j, i, BASE[i * PAGE + j], want);
+}
+
+/* Fails unless every page of the mapping is present and the pages
+   lie one after the other in a huge-page-aligned block. */
+static void
+check_huge (const char *what)
+{
+  char *phys = get_phys_addr (BASE);
+  size_t i;
+
+  if (phys == NULL || (unsigned long) phys % HUGE != 0)
+    fail ("%s: mapping starts at physical %p", what, phys);
+  for (i = 1; i < PAGES; i++)
+    if ((char *) get_phys_addr (BASE + i * PAGE) != phys + i * PAGE)
+      fail ("%s: page %zu is not contiguous", what, i);
+  msg ("%s", what);
+}
+
+void
+test_main (void)
+{
+  struct rss_stat st;
+  pid_t child;
+  size_t i;
+
+  CHECK (mmap (BASE, HUGE, MAP_WRITABLE | MAP_ANONYMOUS, -1, 0) == BASE,
+         "mmap 2 MB anonymous");
+  for (i = 0; i < PAGES; i++)
+    fill (i, 1);
+  check_huge ("filled range is one huge page");
+
+  /* Fork write-protects the range; the child's write copies one
+     page, and neither side may see the other's writes. */
+  child = fork ("child");
+  if (child == 0)
+    {
+      for (i = 0; i < PAGES; i++)
+        check (i, 1);
+      fill (1, 2);
+      check (1, 2);
+      check (2, 1);
+      exit (0);
+    }
+  CHECK (wait (child) == 0, "child reads the range and writes a page");
+  for (i = 0; i < PAGES; i++)
+    check (i, 1);
+  msg ("parent's copy is untouched");
+
+  /* Writing the whole range again makes it writable page by page,
+     and the write to its last page promotes it again. */
+  for (i = 0; i < PAGES; i++)
+    fill (i, 3);
+  check_huge ("rewritten range is one huge page again");
+
+  /* Dropping the upper half splits the huge page; the lower half
+     keeps its data and the upper half reads back zeros. */
+  CHECK (madvise (BASE + HUGE / 2, HUGE / 2, MADV_DONTNEED) == 0,
+         "madvise upper half MADV_DONTNEED");
+  for (i = 0; i < PAGES; i++)
+    check (i, i < PAGES / 2 ? 3 : -1);
+  msg ("lower half survives, upper half is zero");
+  for (i = PAGES / 2; i < PAGES; i++)
+    fill (i, 3);
+  check_huge ("refilled range is one huge page again");
+
+  /* Under a small resident set limit, taking one more frame evicts
+     most of the range. */
+  CHECK (mmap (SCRATCH, PAGE, MAP_WRITABLE | MAP_ANONYMOUS, -1, 0)
+         == SCRATCH, "mmap scratch page");
+  rss_limit (64);
+  SCRATCH[0] = 1;
+  rss_stat (&st);
+  if (st.evicted < PAGES / 2)
+    fail ("only %zu pages evicted", st.evicted);
+  for (i = 0; i < PAGES; i++)
+    check (i, 3);
+  rss_limit (0);
+  msg ("evicted range reads back");
+}
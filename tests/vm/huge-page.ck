@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(huge-page) begin
+(huge-page) mmap 2 MB anonymous
+(huge-page) filled range is one huge page
+(huge-page) child reads the range and writes a page
+(huge-page) parent's copy is untouched
+(huge-page) rewritten range is one huge page again
+(huge-page) madvise upper half MADV_DONTNEED
+(huge-page) lower half survives, upper half is zero
+(huge-page) refilled range is one huge page again
+(huge-page) mmap scratch page
+(huge-page) evicted range reads back
+(huge-page) end
+EOF
+pass;
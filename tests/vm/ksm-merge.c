@@ -0,0 +1,161 @@
+/* Has a parent and its forked children write the same bytes to two
+   pages each, and waits for ksmd to merge every copy into a single
+   frame.  A write to one of the pages must then split it off again,
+   while every other copy keeps its data and stays merged. */
+
+#include <stdbool.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define CHILDREN 2
+#define TRIES 300               /* Sleeps of 100 ms to wait for ksmd. */
+
+#define A ((char *) 0x20000000)
+#define B (A + PAGE)
+
+static const char pattern[] = "ksm-merge";
+
+static int cmd[CHILDREN][2];    /* Parent to child. */
+static int ans[CHILDREN][2];    /* Child to parent. */
+
+/* Fills page P with bytes that no other page should hold. */
+static void
+fill (char *p)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE; i++)
+    p[i] = pattern[i % (sizeof pattern - 1)];
+}
+
+/* Returns true if page P holds what fill() put there, from byte
+   FROM on. */
+static bool
+filled (const char *p, size_t from)
+{
+  size_t i;
+
+  for (i = from; i < PAGE; i++)
+    if (p[i] != pattern[i % (sizeof pattern - 1)])
+      return false;
+  return true;
+}
+
+/* Fills the child's own pages, then answers the parent: 'p' asks
+   for the frame of its page A, 'c' whether both of its pages still
+   hold their data, and anything else tells it to exit. */
+static void
+child (int i)
+{
+  char c;
+
+  fill (A);
+  fill (B);
+  while (read (cmd[i][0], &c, 1) == 1)
+    if (c == 'p')
+      {
+        void *pa = get_phys_addr (A);
+        write (ans[i][1], &pa, sizeof pa);
+      }
+    else if (c == 'c')
+      {
+        char ok = filled (A, 0) && filled (B, 0);
+        write (ans[i][1], &ok, 1);
+      }
+    else
+      break;
+  exit (0);
+}
+
+/* Sends command C to child I and reads back a SIZE-byte answer into
+   ANSWER. */
+static void
+ask (int i, char c, void *answer, size_t size)
+{
+  write (cmd[i][1], &c, 1);
+  if (read (ans[i][0], answer, size) != (int) size)
+    fail ("child %d did not answer '%c'", i, c);
+}
+
+/* Returns true if all copies of the page map one frame. */
+static bool
+all_merged (void)
+{
+  void *pa = get_phys_addr (A);
+  int i;
+
+  if (get_phys_addr (B) != pa)
+    return false;
+  for (i = 0; i < CHILDREN; i++)
+    {
+      void *child_pa;
+
+      ask (i, 'p', &child_pa, sizeof child_pa);
+      if (child_pa != pa)
+        return false;
+    }
+  return true;
+}
+
+void
+test_main (void)
+{
+  pid_t pids[CHILDREN];
+  int i, tries;
+
+  CHECK (mmap (A, 2 * PAGE, MAP_WRITABLE | MAP_ANONYMOUS, -1, 0) == A,
+         "mmap 2 pages anonymous");
+  for (i = 0; i < CHILDREN; i++)
+    {
+      if (pipe (cmd[i]) != 0 || pipe (ans[i]) != 0)
+        fail ("pipe failed");
+      pids[i] = fork ("child");
+      if (pids[i] == 0)
+        child (i);
+      if (pids[i] < 0)
+        fail ("fork %d failed", i);
+    }
+  fill (A);
+  fill (B);
+
+  /* ksmd runs at the lowest priority, so sleep rather than spin
+     while it makes its passes. */
+  for (tries = 0; !all_merged (); tries++)
+    {
+      if (tries == TRIES)
+        fail ("ksmd did not merge the pages");
+      poll (NULL, 0, 100);
+    }
+  msg ("all %d copies share one frame", 2 * (CHILDREN + 1));
+  if (!filled (A, 0) || !filled (B, 0))
+    fail ("merged pages lost their data");
+
+  A[0] = 'x';
+  CHECK (get_phys_addr (A) != get_phys_addr (B), "write splits the page off");
+  if (A[0] != 'x' || !filled (A, 1) || !filled (B, 0))
+    fail ("split page has the wrong data");
+  for (i = 0; i < CHILDREN; i++)
+    {
+      void *child_pa;
+      char ok;
+
+      ask (i, 'c', &ok, 1);
+      if (!ok)
+        fail ("child %d lost its data", i);
+      ask (i, 'p', &child_pa, sizeof child_pa);
+      if (child_pa != get_phys_addr (B))
+        fail ("child %d's page is not merged anymore", i);
+    }
+  msg ("other copies keep their data and stay merged");
+
+  for (i = 0; i < CHILDREN; i++)
+    {
+      char q = 'q';
+
+      write (cmd[i][1], &q, 1);
+      if (wait (pids[i]) != 0)
+        fail ("child %d failed", i);
+    }
+}
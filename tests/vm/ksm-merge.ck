@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(ksm-merge) begin
+(ksm-merge) mmap 2 pages anonymous
+(ksm-merge) all 6 copies share one frame
+(ksm-merge) write splits the page off
+(ksm-merge) other copies keep their data and stay merged
+(ksm-merge) end
+EOF
+pass;
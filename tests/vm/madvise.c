@@ -0,0 +1,86 @@
+/* Exercises madvise().  MADV_DONTNEED frees the pages of anonymous
+   memory, which read back as zeros, and writes the dirty pages of a
+   file mapping back before freeing them, so that they read back as
+   the file's contents.  A file mapping is then scanned under each
+   access-pattern hint and after MADV_WILLNEED, which must not change
+   what it reads, and bad arguments are refused. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define PAGES 64
+#define SIZE (PAGES * 4096)
+
+/* Scans the mapping of "data" and fails unless it reads back what
+   was written. */
+static void
+scan (const char *advice)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (ACTUAL[i] != (char) (i % 251))
+      fail ("byte %zu reads %d after %s", i, ACTUAL[i], advice);
+}
+
+void
+test_main (void)
+{
+  struct rss_stat before, after;
+  int handle;
+  char *p;
+  size_t i;
+
+  p = mmap (NULL, SIZE, MAP_WRITABLE | MAP_ANONYMOUS, -1, 0);
+  CHECK (p != MAP_FAILED, "mmap anonymous memory");
+  memset (p, 0x5a, SIZE);
+  rss_stat (&before);
+  CHECK (madvise (p, SIZE / 2, MADV_DONTNEED) == 0,
+         "madvise anonymous memory DONTNEED");
+  rss_stat (&after);
+  if (after.rss + PAGES / 2 > before.rss)
+    fail ("%zu pages resident before, %zu after", before.rss, after.rss);
+  for (i = 0; i < SIZE; i++)
+    if (p[i] != (i < SIZE / 2 ? 0 : 0x5a))
+      fail ("byte %zu reads %d", i, p[i]);
+  msg ("dropped pages read back as zeros");
+  munmap (p);
+
+  CHECK (create ("data", SIZE), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (mmap (ACTUAL, SIZE, MAP_WRITABLE, handle, 0) != MAP_FAILED,
+         "mmap \"data\"");
+  for (i = 0; i < SIZE; i++)
+    ACTUAL[i] = i % 251;
+  CHECK (madvise (ACTUAL, SIZE, MADV_DONTNEED) == 0,
+         "madvise \"data\" DONTNEED");
+  scan ("DONTNEED");
+  msg ("dropped pages read back from the file");
+
+  CHECK (madvise (ACTUAL, SIZE, MADV_DONTNEED) == 0
+         && madvise (ACTUAL, SIZE, MADV_SEQUENTIAL) == 0,
+         "madvise \"data\" SEQUENTIAL");
+  scan ("SEQUENTIAL");
+  CHECK (madvise (ACTUAL, SIZE, MADV_DONTNEED) == 0
+         && madvise (ACTUAL, SIZE, MADV_RANDOM) == 0,
+         "madvise \"data\" RANDOM");
+  scan ("RANDOM");
+  CHECK (madvise (ACTUAL, SIZE, MADV_DONTNEED) == 0
+         && madvise (ACTUAL, SIZE, MADV_NORMAL) == 0
+         && madvise (ACTUAL, SIZE, MADV_WILLNEED) == 0,
+         "madvise \"data\" WILLNEED");
+  scan ("WILLNEED");
+  msg ("hints leave the contents alone");
+
+  CHECK (madvise (ACTUAL + 1, 4096, MADV_DONTNEED) == -1,
+         "madvise misaligned");
+  CHECK (madvise (ACTUAL, SIZE, 99) == -1, "madvise bad advice");
+  CHECK (madvise (ACTUAL, SIZE + 4096, MADV_DONTNEED) == -1,
+         "madvise unmapped");
+
+  munmap (ACTUAL);
+  close (handle);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) mmap anonymous memory
+(madvise) madvise anonymous memory DONTNEED
+(madvise) dropped pages read back as zeros
+(madvise) create "data"
+(madvise) open "data"
+(madvise) mmap "data"
+(madvise) madvise "data" DONTNEED
+(madvise) dropped pages read back from the file
+(madvise) madvise "data" SEQUENTIAL
+(madvise) madvise "data" RANDOM
+(madvise) madvise "data" WILLNEED
+(madvise) hints leave the contents alone
+(madvise) madvise misaligned
+(madvise) madvise bad advice
+(madvise) madvise unmapped
+(madvise) end
+EOF
+pass;
@@ -0,0 +1,187 @@
+/* Allocation benchmark for the user malloc().  Churns through
+   thousands of small blocks of random sizes, checking that none of
+   them overlap, then compares time and resident pages per block
+   against giving every object a page of its own with mmap(), the
+   only way to get memory before there was a malloc().  Also checks
+   that freeing everything gives the pages back, that big blocks
+   come and go with their own mappings, and that calloc() and
+   realloc() behave.
+
+   The cycle counts it prints vary from run to run and are not
+   checked; the resident set sizes are. */
+
+#include <malloc.h>
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OBJ_CNT 4096                    /* Live small blocks. */
+#define ROUNDS 4                        /* Passes of churn. */
+#define MAX_SIZE 1024                   /* Biggest small block. */
+#define MAP_CNT 128                     /* Objects mapped one by one. */
+#define BIG_SIZE (256 * 1024)           /* Size of a big block. */
+
+static char *objs[OBJ_CNT];
+static size_t sizes[OBJ_CNT];
+
+static inline unsigned long long
+rdtsc (void)
+{
+  unsigned lo, hi;
+
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((unsigned long long) hi << 32) | lo;
+}
+
+static size_t
+resident (void)
+{
+  struct rss_stat st;
+
+  rss_stat (&st);
+  return st.rss;
+}
+
+/* Fills OBJS[I] with a pattern of its own. */
+static void
+fill (size_t i)
+{
+  memset (objs[i], i % 251, sizes[i]);
+}
+
+/* Fails unless OBJS[I] still holds its pattern. */
+static void
+check (size_t i)
+{
+  size_t j;
+
+  for (j = 0; j < sizes[i]; j++)
+    if (objs[i][j] != (char) (i % 251))
+      fail ("block %zu of %zu bytes corrupted at byte %zu",
+            i, sizes[i], j);
+}
+
+void
+test_main (void)
+{
+  unsigned long long start, malloc_cycles, mmap_cycles;
+  size_t base, peak, pages, ops = 0;
+  size_t i, r;
+  volatile size_t huge = (size_t) -1 / 2;
+  char *p;
+
+  random_init (0x5eed);
+  memset (objs, 0, sizeof objs);
+  memset (sizes, 0, sizeof sizes);
+  free (malloc (1));
+  base = resident ();
+
+  /* Fill every slot, then free and reallocate slots at random. */
+  start = rdtsc ();
+  for (r = 0; r <= ROUNDS; r++)
+    for (i = 0; i < OBJ_CNT; i++)
+      {
+        size_t k = r == 0 ? i : random_ulong () % OBJ_CNT;
+
+        if (objs[k] != NULL)
+          {
+            check (k);
+            free (objs[k]);
+            ops++;
+          }
+        sizes[k] = random_ulong () % MAX_SIZE + 1;
+        objs[k] = malloc (sizes[k]);
+        if (objs[k] == NULL)
+          fail ("malloc (%zu) failed", sizes[k]);
+        fill (k);
+        ops++;
+      }
+  malloc_cycles = (rdtsc () - start) / ops;
+  for (i = 0; i < OBJ_CNT; i++)
+    check (i);
+  msg ("%d blocks survive %d rounds of churn", OBJ_CNT, ROUNDS);
+
+  peak = resident ();
+  pages = peak - base;
+  msg ("bench: malloc: %llu cycles per call, %zu pages for %d blocks",
+       malloc_cycles, pages, OBJ_CNT);
+  if (pages >= OBJ_CNT / 4)
+    fail ("%zu pages resident for %d blocks of up to %d bytes",
+          pages, OBJ_CNT, MAX_SIZE);
+  msg ("blocks share pages");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    free (objs[i]);
+  /* The spare slab gives its pages back too, so only a few pages
+     of stack and the like may have come in since BASE. */
+  if (resident () > base + 4)
+    fail ("%zu pages still resident after freeing everything, "
+          "%zu before", resident (), base);
+  msg ("freeing everything gives the pages back");
+
+  /* The same objects, one mapping each. */
+  start = rdtsc ();
+  for (i = 0; i < MAP_CNT; i++)
+    {
+      sizes[i] = random_ulong () % MAX_SIZE + 1;
+      objs[i] = mmap (NULL, sizes[i], MAP_WRITABLE | MAP_ANONYMOUS, -1, 0);
+      if (objs[i] == MAP_FAILED)
+        fail ("mmap (%zu) failed", sizes[i]);
+      fill (i);
+    }
+  pages = resident () - base;
+  for (i = 0; i < MAP_CNT; i++)
+    munmap (objs[i]);
+  mmap_cycles = (rdtsc () - start) / (2 * MAP_CNT);
+  msg ("bench: mmap: %llu cycles per call, %zu pages for %d objects",
+       mmap_cycles, pages, MAP_CNT);
+
+  /* Big blocks have their own mappings. */
+  p = malloc (BIG_SIZE);
+  CHECK (p != NULL, "malloc (%d)", BIG_SIZE);
+  memset (p, 0x5a, BIG_SIZE);
+  if (resident () < base + BIG_SIZE / 4096)
+    fail ("big block is not resident");
+  free (p);
+  if (resident () >= base + BIG_SIZE / 4096)
+    fail ("big block still resident after free");
+  msg ("big block goes away when freed");
+
+  /* calloc() zeroes even a reused block. */
+  p = malloc (100);
+  memset (p, 0xff, 100);
+  free (p);
+  p = calloc (10, 10);
+  for (i = 0; i < 100; i++)
+    if (p[i] != 0)
+      fail ("calloc'd byte %zu is %d", i, p[i]);
+  free (p);
+  /* HUGE is volatile so that GCC cannot see the overflow and warn
+     about it at compile time. */
+  CHECK (calloc (huge, 4) == NULL, "calloc overflow fails");
+
+  /* realloc() keeps the contents as a block grows from small to
+     big and shrinks again. */
+  p = malloc (16);
+  for (i = 0; i < 16; i++)
+    p[i] = i;
+  for (r = 32; r <= BIG_SIZE; r *= 2)
+    {
+      p = realloc (p, r);
+      if (p == NULL)
+        fail ("realloc (%zu) failed", r);
+      for (i = 0; i < r / 2; i++)
+        if (p[i] != (char) i)
+          fail ("realloc (%zu) lost byte %zu", r, i);
+      for (; i < r; i++)
+        p[i] = i;
+    }
+  p = realloc (p, 100);
+  for (i = 0; i < 100; i++)
+    if (p[i] != (char) i)
+      fail ("shrinking realloc lost byte %zu", i);
+  free (p);
+  msg ("realloc keeps contents");
+}
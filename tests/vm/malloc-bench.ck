@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/^\(malloc-bench\) bench: /, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(malloc-bench) begin
+(malloc-bench) 4096 blocks survive 4 rounds of churn
+(malloc-bench) blocks share pages
+(malloc-bench) freeing everything gives the pages back
+(malloc-bench) malloc (262144)
+(malloc-bench) big block goes away when freed
+(malloc-bench) calloc overflow fails
+(malloc-bench) realloc keeps contents
+(malloc-bench) end
+malloc-bench: exit(0)
+EOF
+pass;
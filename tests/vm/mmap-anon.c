@@ -0,0 +1,54 @@
+/* Maps anonymous memory at an address the kernel picks, checks
+   that it starts out zero and keeps what is written to it, that a
+   forked child gets a private copy, and that munmap() removes it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (8 * 4096)
+
+void
+test_main (void)
+{
+  char *p, *q;
+  pid_t child;
+  size_t i;
+
+  p = mmap (NULL, SIZE, MAP_WRITABLE | MAP_ANONYMOUS, -1, 0);
+  CHECK (p != MAP_FAILED, "mmap anonymous memory");
+  if ((uintptr_t) p % 4096 != 0)
+    fail ("mapping at %p is not page-aligned", p);
+  for (i = 0; i < SIZE; i++)
+    if (p[i] != 0)
+      fail ("byte %zu is %d, not zero", i, p[i]);
+  msg ("mapping is zero-filled");
+
+  for (i = 0; i < SIZE; i += 4096)
+    p[i] = i / 4096 + 1;
+  q = mmap (NULL, SIZE, MAP_WRITABLE | MAP_ANONYMOUS, -1, 0);
+  CHECK (q != MAP_FAILED, "mmap more anonymous memory");
+  if (q < p + SIZE && p < q + SIZE)
+    fail ("mappings at %p and %p overlap", p, q);
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      for (i = 0; i < SIZE; i += 4096)
+        if (p[i] != (char) (i / 4096 + 1))
+          fail ("child reads %d at page %zu", p[i], i / 4096);
+      memset (p, 0xff, SIZE);
+      exit (0);
+    }
+  CHECK (wait (child) == 0, "wait for child");
+  for (i = 0; i < SIZE; i += 4096)
+    if (p[i] != (char) (i / 4096 + 1))
+      fail ("parent reads %d at page %zu", p[i], i / 4096);
+  msg ("child's writes stay in the child");
+
+  munmap (p);
+  munmap (q);
+  p[0] = 0;
+  fail ("write to unmapped memory succeeded");
+}
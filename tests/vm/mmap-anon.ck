@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mmap-anon) begin
+(mmap-anon) mmap anonymous memory
+(mmap-anon) mapping is zero-filled
+(mmap-anon) mmap more anonymous memory
+child: exit(0)
+(mmap-anon) wait for child
+(mmap-anon) child's writes stay in the child
+mmap-anon: exit(-1)
+EOF
+pass;
@@ -0,0 +1,48 @@
+/* Writes to a file through a mapping spanning several pages,
+   flushes it with msync(MS_SYNC) while it is still mapped, and
+   reads the data back with the read system call to verify.  Then
+   checks that bad msync() arguments are refused. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define SIZE (3 * 4096 + 100)
+
+void
+test_main (void)
+{
+  static char buf[SIZE];
+  int handle;
+  void *map;
+  size_t i;
+
+  CHECK (create ("data", SIZE), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK ((map = mmap (ACTUAL, SIZE, MAP_WRITABLE, handle, 0)) != MAP_FAILED,
+         "mmap \"data\"");
+
+  /* Dirty the first page and the last two, leaving a clean one. */
+  for (i = 0; i < SIZE; i++)
+    if (i < 4096 || i >= 2 * 4096)
+      ACTUAL[i] = i % 251;
+  CHECK (msync (map, SIZE, MS_SYNC) == 0, "msync \"data\"");
+
+  CHECK (read (handle, buf, SIZE) == SIZE, "read \"data\"");
+  for (i = 0; i < SIZE; i++)
+    {
+      char expected = i < 4096 || i >= 2 * 4096 ? i % 251 : 0;
+      if (buf[i] != expected)
+        fail ("byte %zu of \"data\" is %d, not %d", i, buf[i], expected);
+    }
+  msg ("file matches the mapping");
+
+  CHECK (msync (ACTUAL + 1, 4096, MS_SYNC) == -1, "msync misaligned");
+  CHECK (msync (map, SIZE, MS_SYNC | MS_ASYNC) == -1, "msync bad flags");
+  CHECK (msync (ACTUAL + 8 * 4096, 4096, MS_SYNC) == -1, "msync unmapped");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-msync) begin
+(mmap-msync) create "data"
+(mmap-msync) open "data"
+(mmap-msync) mmap "data"
+(mmap-msync) msync "data"
+(mmap-msync) read "data"
+(mmap-msync) file matches the mapping
+(mmap-msync) msync misaligned
+(mmap-msync) msync bad flags
+(mmap-msync) msync unmapped
+(mmap-msync) end
+EOF
+pass;
@@ -0,0 +1,48 @@
+/* Maps a large file with MAP_POPULATE, closes it, and then checks
+   that every page is present before anything touches it, and
+   then checks the mapping against the file read back with the
+   read system call. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+
+void
+test_main (void)
+{
+  static char buf[4096];
+  int handle;
+  size_t size, ofs;
+  void *map;
+
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+  size = filesize (handle);
+  CHECK ((map = mmap (ACTUAL, size, MAP_POPULATE, handle, 0)) != MAP_FAILED,
+         "mmap \"large.txt\" with MAP_POPULATE");
+  close (handle);
+
+  /* Nothing has touched the mapping yet, so every page must
+     already be present. */
+  for (ofs = 0; ofs < size; ofs += 4096)
+    if (get_phys_addr (ACTUAL + ofs) == 0)
+      fail ("page at %zu was not populated", ofs);
+  msg ("every page is populated");
+
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\" again");
+  for (ofs = 0; ofs < size; ofs += sizeof buf)
+    {
+      size_t chunk = size - ofs < sizeof buf ? size - ofs : sizeof buf;
+
+      if (read (handle, buf, chunk) != (int) chunk)
+        fail ("read of \"large.txt\" at %zu failed", ofs);
+      if (memcmp (ACTUAL + ofs, buf, chunk))
+        fail ("mmap'd data at %zu differs from the file", ofs);
+    }
+  msg ("mapping matches the file");
+
+  munmap (map);
+  close (handle);
+}
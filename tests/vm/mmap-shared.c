@@ -0,0 +1,59 @@
+/* Maps a file MAP_SHARED and forks.  The child's writes through
+   its copy of the mapping must show up in the parent's, and both
+   must agree with read() and write() on the file while it is
+   still mapped, without msync() or munmap(). */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define SIZE (2 * 4096)
+
+static const char parent_msg[] = "written by the parent";
+static const char child_msg[] = "written by the child";
+static const char file_msg[] = "written with write()";
+
+void
+test_main (void)
+{
+  char buf[sizeof child_msg];
+  int handle;
+  pid_t child;
+
+  CHECK (create ("data", SIZE), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (mmap (ACTUAL, SIZE, MAP_WRITABLE | MAP_SHARED, handle, 0)
+         != MAP_FAILED, "mmap \"data\" shared");
+  strlcpy (ACTUAL, parent_msg, sizeof parent_msg);
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      if (strcmp (ACTUAL, parent_msg))
+        fail ("child sees \"%s\"", ACTUAL);
+      strlcpy (ACTUAL + 4096, child_msg, sizeof child_msg);
+      exit (0);
+    }
+  CHECK (wait (child) == 0, "wait for child");
+  if (strcmp (ACTUAL + 4096, child_msg))
+    fail ("parent sees \"%s\"", ACTUAL + 4096);
+  msg ("parent sees the child's write");
+
+  seek (handle, 4096);
+  CHECK (read (handle, buf, sizeof buf) == sizeof buf, "read \"data\"");
+  if (strcmp (buf, child_msg))
+    fail ("read() sees \"%s\"", buf);
+  msg ("read() sees the child's write");
+
+  seek (handle, 0);
+  CHECK (write (handle, file_msg, sizeof file_msg) == sizeof file_msg,
+         "write \"data\"");
+  if (strcmp (ACTUAL, file_msg))
+    fail ("mapping sees \"%s\"", ACTUAL);
+  msg ("mapping sees write()");
+
+  munmap (ACTUAL);
+  close (handle);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-shared) begin
+(mmap-shared) create "data"
+(mmap-shared) open "data"
+(mmap-shared) mmap "data" shared
+(mmap-shared) wait for child
+(mmap-shared) parent sees the child's write
+(mmap-shared) read "data"
+(mmap-shared) read() sees the child's write
+(mmap-shared) write "data"
+(mmap-shared) mapping sees write()
+(mmap-shared) end
+EOF
+pass;
@@ -0,0 +1,47 @@
+/* Limits the resident set and writes to more pages than it
+   allows.  The process has to stay under its limit by evicting
+   its own pages, which must still read back correctly, and a
+   forked child has to inherit the limit. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LIMIT 32
+#define PAGES 128
+
+static char buf[PAGES * 4096];
+
+void
+test_main (void)
+{
+  struct rss_stat st;
+  pid_t child;
+  size_t i;
+
+  rss_limit (LIMIT);
+  for (i = 0; i < PAGES; i++)
+    buf[i * 4096] = i;
+
+  rss_stat (&st);
+  if (st.limit != LIMIT)
+    fail ("limit is %zu, not %d", st.limit, LIMIT);
+  if (st.rss > LIMIT)
+    fail ("%zu pages resident, limit is %d", st.rss, LIMIT);
+  if (st.evicted < PAGES - LIMIT)
+    fail ("only %zu pages evicted", st.evicted);
+  msg ("resident set stays under the limit");
+
+  for (i = 0; i < PAGES; i++)
+    if (buf[i * 4096] != (char) i)
+      fail ("page %zu reads back %d", i, buf[i * 4096]);
+  msg ("evicted pages read back");
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      rss_stat (&st);
+      exit (st.limit == LIMIT ? 0 : 1);
+    }
+  CHECK (wait (child) == 0, "child inherits the limit");
+}
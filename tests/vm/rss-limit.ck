@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rss-limit) begin
+(rss-limit) resident set stays under the limit
+(rss-limit) evicted pages read back
+(rss-limit) child inherits the limit
+(rss-limit) end
+EOF
+pass;
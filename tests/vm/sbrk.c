@@ -0,0 +1,35 @@
+/* Grows the heap with sbrk(), writes to it, shrinks it back, and
+   grows it again, which must give fresh zeroed pages. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (16 * 4096)
+
+void
+test_main (void)
+{
+  char *start, *p;
+  size_t i;
+
+  start = sbrk (0);
+  CHECK (sbrk (SIZE) == start, "sbrk (%d)", SIZE);
+  CHECK (sbrk (0) == start + SIZE, "break moved up");
+  for (i = 0; i < SIZE; i++)
+    start[i] = i % 251;
+  for (i = 0; i < SIZE; i++)
+    if (start[i] != (char) (i % 251))
+      fail ("byte %zu of the heap reads %d", i, start[i]);
+  msg ("heap keeps what is written");
+
+  CHECK (sbrk (-SIZE) == start + SIZE, "sbrk (-%d)", SIZE);
+  CHECK (sbrk (-1) == (void *) -1, "sbrk below the heap fails");
+
+  p = sbrk (SIZE);
+  CHECK (p == start, "sbrk (%d) again", SIZE);
+  for (i = 0; i < SIZE; i++)
+    if (p[i] != 0)
+      fail ("byte %zu of the regrown heap is %d", i, p[i]);
+  msg ("regrown heap is zero-filled");
+}
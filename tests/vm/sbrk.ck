@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sbrk) begin
+(sbrk) sbrk (65536)
+(sbrk) break moved up
+(sbrk) heap keeps what is written
+(sbrk) sbrk (-65536)
+(sbrk) sbrk below the heap fails
+(sbrk) sbrk (65536) again
+(sbrk) regrown heap is zero-filled
+(sbrk) end
+EOF
+pass;
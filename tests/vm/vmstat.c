@@ -0,0 +1,96 @@
+/* Checks the counters of vmstat().  Touching fresh pages of an area
+   without fault-around takes a fault per page, each of which lands
+   in the latency histogram; a big stack frame grows the stack; and
+   a resident set limit evicts pages that fault back in from swap.
+   The system's counters include everything the process counted. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 64
+#define SIZE (PAGES * 4096)
+#define LIMIT 16
+
+/* Sum of the buckets of ST's latency histogram. */
+static long long
+histogram_sum (const struct vm_stat *st)
+{
+  long long sum = 0;
+  int i;
+
+  for (i = 0; i < VMSTAT_LAT_BUCKETS; i++)
+    sum += st->fault_latency[i];
+  return sum;
+}
+
+/* Touches a stack frame big enough to grow the stack. */
+static void __attribute__ ((noinline))
+use_stack (void)
+{
+  volatile char buf[16 * 4096];
+  size_t i;
+
+  for (i = 0; i < sizeof buf; i += 4096)
+    buf[i] = i;
+}
+
+void
+test_main (void)
+{
+  struct vm_stat before, after, sys;
+  char *p;
+  size_t i;
+
+  p = mmap (NULL, SIZE, MAP_WRITABLE | MAP_ANONYMOUS, -1, 0);
+  CHECK (p != MAP_FAILED, "mmap anonymous memory");
+  CHECK (madvise (p, SIZE, MADV_RANDOM) == 0, "madvise RANDOM");
+  vmstat (&before, false);
+  for (i = 0; i < SIZE; i += 4096)
+    p[i] = 1;
+  vmstat (&after, false);
+  if (after.minor_faults + after.major_faults
+      < before.minor_faults + before.major_faults + PAGES)
+    fail ("%lld faults counted for touching %d pages",
+          after.minor_faults + after.major_faults
+          - before.minor_faults - before.major_faults, PAGES);
+  msg ("a fault per page");
+  if (histogram_sum (&after) != after.minor_faults + after.major_faults)
+    fail ("histogram holds %lld faults of %lld", histogram_sum (&after),
+          after.minor_faults + after.major_faults);
+  msg ("latency histogram holds every fault");
+
+  vmstat (&before, false);
+  use_stack ();
+  vmstat (&after, false);
+  CHECK (after.stack_faults > before.stack_faults, "stack growth counted");
+
+  /* Pages over the limit are evicted to swap, and faulting them
+     back in swaps them in. */
+  vmstat (&before, false);
+  rss_limit (LIMIT);
+  for (i = 0; i < SIZE; i++)
+    p[i] = i % 251;
+  for (i = 0; i < SIZE; i++)
+    if (p[i] != (char) (i % 251))
+      fail ("byte %zu reads %d", i, p[i]);
+  rss_limit (0);
+  vmstat (&after, false);
+  if (after.anon_evictions - before.anon_evictions < PAGES - LIMIT)
+    fail ("%lld evictions counted under a limit of %d pages for %d",
+          after.anon_evictions - before.anon_evictions, LIMIT, PAGES);
+  CHECK (after.swap_ins > before.swap_ins, "evictions and swap-ins counted");
+
+  vmstat (&sys, true);
+  vmstat (&after, false);
+  if (sys.minor_faults < after.minor_faults
+      || sys.major_faults < after.major_faults
+      || sys.stack_faults < after.stack_faults
+      || sys.anon_evictions < after.anon_evictions
+      || sys.swap_ins < after.swap_ins
+      || sys.swap_outs < after.swap_outs)
+    fail ("system counters below the process's");
+  msg ("system counters include the process's");
+  munmap (p);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(vmstat) begin
+(vmstat) mmap anonymous memory
+(vmstat) madvise RANDOM
+(vmstat) a fault per page
+(vmstat) latency histogram holds every fault
+(vmstat) stack growth counted
+(vmstat) evictions and swap-ins counted
+(vmstat) system counters include the process's
+(vmstat) end
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Checks that untouched anonymous pages that are only read share
+   one zero frame, and that writing one, from user code or from a
+   system call, gives it a zeroed frame of its own. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_COUNT 64
+
+static char buf[PAGE_COUNT * PAGE_SIZE];
+
+void
+test_main (void)
+{
+	static const char msg_text[] = "written by the kernel";
+	char out[sizeof msg_text];
+	void *zero;
+	size_t i;
+	int fds[2];
+
+	for (i = 0; i < sizeof buf; i++)
+		if (buf[i] != 0)
+			fail ("byte %zu is %d, not zero", i, buf[i]);
+	zero = get_phys_addr (&buf[0]);
+	for (i = 0; i < PAGE_COUNT; i++)
+		if (get_phys_addr (&buf[i * PAGE_SIZE]) != zero)
+			fail ("page %zu does not share the zero frame", i);
+	msg ("read pages share one frame");
+
+	buf[3 * PAGE_SIZE + 5] = 'x';
+	CHECK (get_phys_addr (&buf[3 * PAGE_SIZE]) != zero,
+			"written page has its own frame");
+	CHECK (get_phys_addr (&buf[4 * PAGE_SIZE]) == zero,
+			"other pages still share the zero frame");
+	for (i = 3 * PAGE_SIZE; i < 4 * PAGE_SIZE; i++)
+		if (buf[i] != (i == 3 * PAGE_SIZE + 5 ? 'x' : 0))
+			fail ("byte %zu of the written page is wrong", i);
+
+	CHECK (pipe (fds) == 0, "pipe");
+	CHECK (write (fds[1], msg_text, sizeof msg_text) == sizeof msg_text,
+			"write pipe");
+	CHECK (read (fds[0], &buf[10 * PAGE_SIZE], sizeof msg_text)
+			== sizeof msg_text, "read pipe into a zero page");
+	memcpy (out, &buf[10 * PAGE_SIZE], sizeof out);
+	CHECK (!strcmp (out, msg_text), "page holds what was read");
+	CHECK (buf[11 * PAGE_SIZE] == 0 && buf[PAGE_SIZE] == 0,
+			"neighbours are still zero");
+}
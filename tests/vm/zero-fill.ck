@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(zero-fill) begin
+(zero-fill) read pages share one frame
+(zero-fill) written page has its own frame
+(zero-fill) other pages still share the zero frame
+(zero-fill) pipe
+(zero-fill) write pipe
+(zero-fill) read pipe into a zero page
+(zero-fill) page holds what was read
+(zero-fill) neighbours are still zero
+(zero-fill) end
+EOF
+pass;
@@ -21,6 +21,7 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -31,6 +32,7 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
@@ -41,6 +43,8 @@
 /* Page-map-level-4 with kernel mappings only. */
 uint64_t *base_pml4;
 
+#define CR4_PGE 0x80            /* Page global enable. */
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -140,31 +144,61 @@ bss_init (void) {
 	memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* Returns the table that entry IDX of TABLE points to, creating it
+ * if it is not there yet. */
+static uint64_t *
+kernel_table (uint64_t *table, unsigned idx) {
+	if (!(table[idx] & PTE_P))
+		table[idx] = vtop (palloc_get_page (PAL_ASSERT | PAL_ZERO))
+			| PTE_U | PTE_W | PTE_P;
+	return ptov (PTE_ADDR (table[idx]));
+}
+
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
- * Points base_pml4 to the pml4 it creates. */
+ * Points base_pml4 to the pml4 it creates.
+ *
+ * Memory is mapped with 2 MB pages wherever it can be, and with
+ * 4 KB pages only in the 2 MB ranges that hold part of the
+ * read-only kernel text or run past MEM_END.  (KERN_BASE is not
+ * 1 GB-aligned, so 1 GB pages never fit.)  Every kernel mapping is
+ * global, so that switching page tables keeps it in the TLB. */
 static void
 paging_init (uint64_t mem_end) {
-	uint64_t *pml4, *pte;
+	uint64_t *pml4, *pdpe, *pde, *pte;
 	int perm;
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
+	uint64_t text_start = (uint64_t) &start;
+	uint64_t text_end = (uint64_t) &_end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	for (uint64_t pa = 0; pa < mem_end; ) {
 		uint64_t va = (uint64_t) ptov(pa);
 
-		perm = PTE_P | PTE_W;
-		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
+		pdpe = kernel_table (pml4, PML4 (va));
+		pde = kernel_table (pdpe, PDPE (va));
+		if (pa % HPGSIZE == 0 && pa + HPGSIZE <= mem_end
+				&& (va + HPGSIZE <= text_start || text_end <= va)) {
+			pde[PDX (va)] = pa | PTE_PS | PTE_G | PTE_W | PTE_P;
+			pa += HPGSIZE;
+			continue;
+		}
+
+		perm = PTE_G | PTE_P | PTE_W;
+		if (text_start <= va && va < text_end)
 			perm &= ~PTE_W;
 
-		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
-			*pte = pa | perm;
+		pte = kernel_table (pde, PDX (va));
+		pte[PTX (va)] = pa | perm;
+		pa += PGSIZE;
 	}
 
-	// reload cr3
+	// reload cr3, then keep kernel TLB entries across later reloads
 	pml4_activate(0);
+	lcr4 (rcr4 () | CR4_PGE);
+	pml4_pcid_init ();
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -364,4 +398,8 @@ print_stats (void) {
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	zswap_print_stats ();
+	vm_print_stats ();
+#endif
 }
@@ -2,12 +2,154 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Process-context identifiers.  With CR4.PCIDE set, TLB entries are
+ * tagged with the PCID in the low bits of CR3, so loading CR3 with
+ * CR3_NOFLUSH keeps every address space's entries instead of
+ * flushing them.  PCID 0 belongs to base_pml4; the others are
+ * handed out to page tables as they are activated and taken back
+ * round-robin when they run out.
+ *
+ * An entry of a page table that is not loaded cannot be invlpg'd,
+ * so changing one marks its PCID stale instead, and the next
+ * activation flushes it.  A page table that has lost its PCID has
+ * nothing left in the TLB. */
+#define PCID_CNT 64
+#define CR3_NOFLUSH (1ULL << 63)
+#define CR4_PCIDE 0x20000
+#define CPUID_PCID (1 << 17)    /* In ECX of CPUID leaf 1. */
+static bool pcid_enabled;
+static uint64_t *pcid_owner[PCID_CNT];  /* Page table using each PCID. */
+static bool pcid_stale[PCID_CNT];       /* Must flush on next load? */
+static unsigned pcid_hand = 1;          /* Next PCID to take back. */
+
+/* Returns true if PML4 is the page table the CPU is using. */
+static bool
+pml4_is_current (uint64_t *pml4) {
+	return PTE_ADDR (rcr3 ()) == vtop (pml4);
+}
+
+/* Returns the PCID that PML4 holds, or 0 if it holds none. */
+static unsigned
+pcid_find (uint64_t *pml4) {
+	for (unsigned pcid = 1; pcid < PCID_CNT; pcid++)
+		if (pcid_owner[pcid] == pml4)
+			return pcid;
+	return 0;
+}
+
+/* Invalidates the TLB entry for VA in PML4: at once if PML4 is
+ * loaded, otherwise the next time it is. */
+static void
+tlb_invalidate (uint64_t *pml4, uint64_t va) {
+	if (pml4_is_current (pml4))
+		invlpg (va);
+	else if (pcid_enabled) {
+		enum intr_level old_level = intr_disable ();
+		unsigned pcid = pcid_find (pml4);
+		if (pcid != 0)
+			pcid_stale[pcid] = true;
+		intr_set_level (old_level);
+	}
+}
+
+/* Invalidates all of PML4's TLB entries but global ones, at once if
+ * PML4 is loaded, otherwise the next time it is. */
+static void
+tlb_flush (uint64_t *pml4) {
+	if (pml4_is_current (pml4))
+		lcr3 (rcr3 ());
+	else
+		tlb_invalidate (pml4, 0);
+}
+
+/* Page tables set aside by pml4_set_huge_page(), so that a huge
+ * page can be split back into small pages without allocating.  A
+ * deposited table is free for our use until then: its first entry
+ * holds the PDE it belongs to and its second the next table. */
+static uint64_t *deposits;
+
+static void
+pt_deposit (uint64_t *pde, uint64_t *pt) {
+	enum intr_level old_level = intr_disable ();
+	pt[0] = (uint64_t) pde;
+	pt[1] = (uint64_t) deposits;
+	deposits = pt;
+	intr_set_level (old_level);
+}
+
+static uint64_t *
+pt_withdraw (uint64_t *pde) {
+	enum intr_level old_level = intr_disable ();
+	uint64_t **prev = &deposits;
+	uint64_t *pt;
+
+	for (pt = deposits; pt != NULL; pt = (uint64_t *) pt[1]) {
+		if (pt[0] == (uint64_t) pde) {
+			*prev = (uint64_t *) pt[1];
+			break;
+		}
+		prev = (uint64_t **) &pt[1];
+	}
+	intr_set_level (old_level);
+	ASSERT (pt != NULL);
+	return pt;
+}
+
+/* Returns the page directory entry for VA in PML4, or a null
+ * pointer if there is no page directory for it. */
+static uint64_t *
+pde_lookup (uint64_t *pml4, uint64_t va) {
+	uint64_t *pdpe, *pde;
+
+	if (!(pml4[PML4 (va)] & PTE_P))
+		return NULL;
+	pdpe = ptov (PTE_ADDR (pml4[PML4 (va)]));
+	if (!(pdpe[PDPE (va)] & PTE_P))
+		return NULL;
+	pde = ptov (PTE_ADDR (pdpe[PDPE (va)]));
+	return &pde[PDX (va)];
+}
+
+/* Returns the PDE that maps VA in PML4 as part of a huge page, or
+ * a null pointer if VA is not in a huge page. */
+static uint64_t *
+huge_pde (uint64_t *pml4, uint64_t va) {
+	uint64_t *pde = pde_lookup (pml4, va);
+	if (pde != NULL && (*pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS))
+		return pde;
+	return NULL;
+}
+
+/* Splits the huge page PDE maps for VA in PML4 into HPGCNT small
+ * pages with the same frames and bits, in its deposited table. */
+static void
+huge_split (uint64_t *pml4, uint64_t *pde, uint64_t va) {
+	uint64_t *pt = pt_withdraw (pde);
+	uint64_t pa = PTE_ADDR (*pde);
+	uint64_t flags = *pde & (PTE_P | PTE_W | PTE_U | PTE_A | PTE_D);
+
+	for (unsigned i = 0; i < HPGCNT; i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+	tlb_invalidate (pml4, (uint64_t) hpg_round_down (va));
+}
+
+/* Returns the entry that maps VA in PML4, which is a PDE if VA is
+ * in a huge page, without splitting it; only the bits the two have
+ * in common may be used.  Returns a null pointer if there is none. */
+static uint64_t *
+pte_lookup (uint64_t *pml4, const uint64_t va) {
+	uint64_t *pde = huge_pde (pml4, va);
+	return pde != NULL ? pde : pml4e_walk (pml4, va, false);
+}
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
@@ -60,13 +202,17 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.  A huge page that covers VADDR is split
+ * first. */
 uint64_t *
 pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	uint64_t *pte = NULL;
 	int idx = PML4 (va);
 	int allocated = 0;
 	if (pml4e) {
+		uint64_t *pde = huge_pde (pml4e, va);
+		if (pde != NULL)
+			huge_split (pml4e, pde, va);
 		uint64_t *pdpe = (uint64_t *) pml4e[idx];
 		if (!((uint64_t) pdpe & PTE_P)) {
 			if (create) {
@@ -122,7 +268,14 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if ((pdp[i] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)) {
+			/* A huge page is visited once, through its PDE. */
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (!func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
@@ -169,7 +322,9 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if ((pdp[i] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS))
+			palloc_free_page (pt_withdraw (&pdp[i]));
+		else if (((uint64_t) pte) & PTE_P)
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -196,14 +351,66 @@ pml4_destroy (uint64_t *pml4) {
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
 		pdpe_destroy ((void *) PTE_ADDR (pdpe));
+
+	/* A new page table at the same address must not inherit our
+	 * TLB entries, so it has to get the PCID afresh.  Give the PCID
+	 * up before the page, or pml4_create () could hand the page out
+	 * again while pcid_find () still knows it. */
+	enum intr_level old_level = intr_disable ();
+	unsigned pcid = pcid_find (pml4);
+	if (pcid != 0)
+		pcid_owner[pcid] = NULL;
+	intr_set_level (old_level);
 	palloc_free_page ((void *) pml4);
 }
 
+/* Turns on PCIDs if the CPU has them.  Must be called with
+ * base_pml4 loaded. */
+void
+pml4_pcid_init (void) {
+	uint32_t eax = 1, ebx, ecx, edx;
+
+	asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+	if (ecx & CPUID_PCID) {
+		pcid_owner[0] = base_pml4;
+		lcr4 (rcr4 () | CR4_PCIDE);
+		pcid_enabled = true;
+	}
+}
+
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  Does nothing if it is loaded already, and keeps the
+ * TLB entries of other address spaces if PCIDs are on. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	enum intr_level old_level;
+	unsigned pcid;
+
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+	if (!pcid_enabled) {
+		if (!pml4_is_current (pml4))
+			lcr3 (vtop (pml4));
+		return;
+	}
+
+	old_level = intr_disable ();
+	pcid = pml4 == base_pml4 ? 0 : pcid_find (pml4);
+	if (pml4 != base_pml4 && pcid == 0) {
+		/* Takes back the next PCID that is not in use right now. */
+		pcid = pcid_hand;
+		if (pcid_owner[pcid] != NULL && pml4_is_current (pcid_owner[pcid]))
+			pcid = pcid % (PCID_CNT - 1) + 1;
+		pcid_hand = pcid % (PCID_CNT - 1) + 1;
+		pcid_owner[pcid] = pml4;
+		pcid_stale[pcid] = true;
+	}
+	if (pcid_stale[pcid]) {
+		pcid_stale[pcid] = false;
+		lcr3 (vtop (pml4) | pcid);
+	} else if (!pml4_is_current (pml4))
+		lcr3 (vtop (pml4) | pcid | CR3_NOFLUSH);
+	intr_set_level (old_level);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -214,6 +421,10 @@ void *
 pml4_get_page (uint64_t *pml4, const void *uaddr) {
 	ASSERT (is_user_vaddr (uaddr));
 
+	uint64_t *pde = huge_pde (pml4, (uint64_t) uaddr);
+	if (pde != NULL)
+		return ptov (PTE_ADDR (*pde)) + ((uint64_t) uaddr & (HPGSIZE - 1));
+
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
 
 	if (pte && (*pte & PTE_P))
@@ -257,8 +468,7 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		tlb_invalidate (pml4, (uint64_t) upage);
 	}
 }
 
@@ -268,7 +478,7 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
  * Returns false if PML4 contains no PTE for VPAGE. */
 bool
 pml4_is_dirty (uint64_t *pml4, const void *vpage) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = pte_lookup (pml4, (uint64_t) vpage);
 	return pte != NULL && (*pte & PTE_D) != 0;
 }
 
@@ -276,15 +486,14 @@ pml4_is_dirty (uint64_t *pml4, const void *vpage) {
  * in PML4. */
 void
 pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = pte_lookup (pml4, (uint64_t) vpage);
 	if (pte) {
 		if (dirty)
 			*pte |= PTE_D;
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, (uint64_t) vpage);
 	}
 }
 
@@ -294,7 +503,7 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
  * PML4 contains no PTE for VPAGE. */
 bool
 pml4_is_accessed (uint64_t *pml4, const void *vpage) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = pte_lookup (pml4, (uint64_t) vpage);
 	return pte != NULL && (*pte & PTE_A) != 0;
 }
 
@@ -302,14 +511,67 @@ pml4_is_accessed (uint64_t *pml4, const void *vpage) {
    VPAGE in PD. */
 void
 pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = pte_lookup (pml4, (uint64_t) vpage);
 	if (pte) {
 		if (accessed)
 			*pte |= PTE_A;
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, (uint64_t) vpage);
+	}
+}
+
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+ * VPAGE in PML4, so that a read-only mapping can be shared and
+ * later made writable again without remapping it. */
+void
+pml4_set_writable (uint64_t *pml4, const void *vpage, bool writable) {
+	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	if (pte) {
+		if (writable)
+			*pte |= PTE_W;
+		else
+			*pte &= ~(uint64_t) PTE_W;
+
+		tlb_invalidate (pml4, (uint64_t) vpage);
 	}
 }
+
+/* Maps the HPGCNT pages from user virtual address UPAGE in PML4 at
+ * once, as one huge page of the contiguous frames starting at
+ * kernel virtual address KPAGE, which must be aligned like UPAGE to
+ * a huge page boundary.  The pages must already be mapped one by
+ * one; their page table is kept to split the huge page again when
+ * one of them is remapped, cleared or write-protected.
+ * Returns true if successful, false if UPAGE has no page table. */
+bool
+pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	uint64_t *pde, *pt;
+	uint64_t flags = PTE_A;
+
+	ASSERT (((uint64_t) upage & (HPGSIZE - 1)) == 0);
+	ASSERT (((uint64_t) kpage & (HPGSIZE - 1)) == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	pde = pde_lookup (pml4, (uint64_t) upage);
+	if (pde == NULL || (*pde & (PTE_P | PTE_PS)) != PTE_P)
+		return false;
+
+	pt = ptov (PTE_ADDR (*pde));
+	for (unsigned i = 0; i < HPGCNT; i++)
+		flags |= pt[i] & PTE_D;
+	*pde = vtop (kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U | flags;
+	pt_deposit (pde, pt);
+
+	tlb_flush (pml4);
+	return true;
+}
+
+/* Returns true if user virtual address VA is mapped in PML4 as part
+ * of a huge page. */
+bool
+pml4_is_huge (uint64_t *pml4, const void *va) {
+	return huge_pde (pml4, (uint64_t) va) != NULL;
+}
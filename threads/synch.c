@@ -432,3 +432,66 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	while (!list_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
+
+/* Initializes wait queue WQ.  A wait queue lets a thread wait for
+   events on several objects at once: it hangs one entry, each
+   pointing to the same semaphore, on every object's queue, and
+   sleeps on the semaphore.  Unlike a condition variable, a wait
+   queue is not tied to a lock and may be woken from an interrupt
+   handler. */
+void
+waitq_init (struct waitq *wq) {
+	ASSERT (wq != NULL);
+
+	list_init (&wq->waiters);
+}
+
+/* Initializes ENTRY to up SEMA when woken. */
+void
+waitq_entry_init (struct waitq_entry *entry, struct semaphore *sema) {
+	ASSERT (entry != NULL);
+	ASSERT (sema != NULL);
+
+	entry->sema = sema;
+	entry->queue = NULL;
+}
+
+/* Queues ENTRY on WQ, unless it is already queued somewhere. */
+void
+waitq_add (struct waitq *wq, struct waitq_entry *entry) {
+	enum intr_level old_level = intr_disable ();
+
+	if (entry->queue == NULL) {
+		entry->queue = wq;
+		list_push_back (&wq->waiters, &entry->elem);
+	}
+	intr_set_level (old_level);
+}
+
+/* Takes ENTRY off the queue it is on, if any. */
+void
+waitq_remove (struct waitq_entry *entry) {
+	enum intr_level old_level = intr_disable ();
+
+	if (entry->queue != NULL) {
+		list_remove (&entry->elem);
+		entry->queue = NULL;
+	}
+	intr_set_level (old_level);
+}
+
+/* Wakes every entry queued on WQ.  Entries are dequeued as they
+   are woken, so a waiter that wants further events must queue
+   itself again before rechecking. */
+void
+waitq_wake (struct waitq *wq) {
+	enum intr_level old_level = intr_disable ();
+
+	while (!list_empty (&wq->waiters)) {
+		struct waitq_entry *entry = list_entry (list_pop_front (&wq->waiters),
+				struct waitq_entry, elem);
+		entry->queue = NULL;
+		sema_up (entry->sema);
+	}
+	intr_set_level (old_level);
+}
@@ -249,8 +249,14 @@ thread_create (const char *name, int priority,
 	
 	t->recent_cpu = thread_current()->recent_cpu;
 
+#ifdef USERPROG
+	if (!process_add_child (t)) {
+		palloc_free_multiple (t->files, FDT_PAGES);
+		palloc_free_page (t);
+		return TID_ERROR;
+	}
+#endif
 	list_push_back(&all_list,&t->all_elem);
-	list_push_back(&thread_current()->child_list,&t->child_elem);
 	
 	if(t->files == NULL)
 		return TID_ERROR;
@@ -533,10 +539,6 @@ init_thread (struct thread *t, const char *name, int priority) {
 	t->recent_cpu = 0;
 	t->fd_idx = 3;
 	t->exit_status = 0;
-	list_init(&t->child_list);
-	sema_init(&t->wait_sema,0);
-	sema_init(&t->child_load_sema,0);
-	sema_init(&t->exit_sema,0);
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
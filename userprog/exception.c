@@ -139,6 +139,10 @@ page_fault (struct intr_frame *f) {
 	not_present = (f->error_code & PF_P) == 0;
 	write = (f->error_code & PF_W) != 0;
 	user = (f->error_code & PF_U) != 0;
+
+	/* Count page faults, the ones served as well as the fatal
+	   ones. */
+	page_fault_cnt++;
 #ifdef VM
 	/* For project 3 and later. */
 	if (vm_try_handle_fault (f, fault_addr, user, write, not_present))
@@ -146,8 +150,6 @@ page_fault (struct intr_frame *f) {
 #endif
 	// printf("fault......%p,%d,%d,%d\n",fault_addr,user,write,not_present);
 	exit(-1);
-	/* Count page faults. */
-	page_fault_cnt++;
 
 	/* If the fault is true fault, show info and exit. */
 	printf ("Page fault at %p: %s error %s page in %s context.\n",
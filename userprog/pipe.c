@@ -0,0 +1,316 @@
+/* pipe.c: Anonymous pipes.
+ *
+ * A pipe is a ring of PIPE_SLOTS page-sized buffers shared by its
+ * read and write ends.  Writers fill the newest slot and start a
+ * new one when it is full; readers drain the oldest slot and give
+ * its page back when it is empty.  Pages are only held while they
+ * carry data, so an idle pipe costs one spare page.
+ *
+ * A page-aligned write of a whole page is handed to the reader as a
+ * slot of its own.  Under VM, when the page is a resident anonymous
+ * one, the slot is the writer's frame itself, lent copy-on-write
+ * with vm_frame_lend(), and a page-aligned reader whose page is
+ * anonymous too gets the frame mapped in its place instead of a
+ * copy, so the data is never copied at all.  Otherwise it is copied
+ * once, without being split across a partially filled slot, and a
+ * page-aligned reader gets it back in one piece.
+ *
+ * Wakeups are batched.  A writer wakes readers once per call, or
+ * when it has to sleep on a full ring, rather than once per slot,
+ * and a reader only wakes writers once half of the ring is free.
+ * Pollers are woken at the same points, and a write end only polls
+ * writable once half of the ring is free. */
+
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <poll.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
+
+/* Number of page buffers in a pipe. */
+#define PIPE_SLOTS 16
+
+/* One page of buffered data. */
+struct pipe_slot {
+	uint8_t *page;              /* Buffer, one page. */
+	struct frame *frame;        /* Writer's frame PAGE is in, if lent. */
+	size_t start;               /* Offset of the first unread byte. */
+	size_t end;                 /* Offset just past the last byte. */
+};
+
+struct pipe {
+	struct lock lock;
+	struct condition readable;  /* Data arrived or writers gone. */
+	struct condition writable;  /* Slots freed or readers gone. */
+	struct waitq pollers;       /* Threads polling either end. */
+	struct pipe_slot slots[PIPE_SLOTS];
+	unsigned head;              /* Oldest slot in use, free running. */
+	unsigned tail;              /* One past the newest slot in use. */
+	uint8_t *spare;             /* Drained page kept for reuse. */
+	int readers;                /* Open read ends. */
+	int writers;                /* Open write ends. */
+	int read_waiters;           /* Readers sleeping on READABLE. */
+	int write_waiters;          /* Writers sleeping on WRITABLE. */
+};
+
+static struct pipe_slot *pipe_tail_slot (struct pipe *, bool whole);
+static void pipe_pop_slot (struct pipe *);
+
+/* Creates a pipe with one read end and one write end open.
+ * Returns a null pointer if memory is exhausted. */
+struct pipe *
+pipe_create (void) {
+	struct pipe *pipe = malloc (sizeof *pipe);
+
+	if (pipe == NULL)
+		return NULL;
+	lock_init (&pipe->lock);
+	cond_init (&pipe->readable);
+	cond_init (&pipe->writable);
+	waitq_init (&pipe->pollers);
+	pipe->head = pipe->tail = 0;
+	pipe->spare = NULL;
+	pipe->readers = pipe->writers = 1;
+	pipe->read_waiters = pipe->write_waiters = 0;
+	return pipe;
+}
+
+/* Opens another read end of PIPE, or another write end if
+ * WRITER. */
+void
+pipe_reopen (struct pipe *pipe, bool writer) {
+	lock_acquire (&pipe->lock);
+	if (writer)
+		pipe->writers++;
+	else
+		pipe->readers++;
+	lock_release (&pipe->lock);
+}
+
+/* Closes a read end of PIPE, or a write end if WRITER.  Closing
+ * the last write end lets readers see end of file; closing the
+ * last read end makes writes fail.  The pipe is freed when both
+ * sides are closed. */
+void
+pipe_close (struct pipe *pipe, bool writer) {
+	bool dead;
+
+	lock_acquire (&pipe->lock);
+	if (writer)
+		pipe->writers--;
+	else
+		pipe->readers--;
+	ASSERT (pipe->readers >= 0 && pipe->writers >= 0);
+	cond_broadcast (&pipe->readable, &pipe->lock);
+	cond_broadcast (&pipe->writable, &pipe->lock);
+	waitq_wake (&pipe->pollers);
+	dead = pipe->readers == 0 && pipe->writers == 0;
+	lock_release (&pipe->lock);
+
+	if (dead) {
+		while (pipe->head != pipe->tail)
+			pipe_pop_slot (pipe);
+		if (pipe->spare != NULL)
+			palloc_free_page (pipe->spare);
+		free (pipe);
+	}
+}
+
+/* Reads up to SIZE bytes from PIPE into BUFFER.  Blocks until at
+ * least one byte is available, or returns 0 at once if not BLOCK,
+ * then returns whatever is buffered up to SIZE.  Returns 0 at end
+ * of file, that is, once the pipe is empty and has no write ends
+ * left.  Under VM, BUFFER must be pinned with vm_pin_user_page(),
+ * so that copying into it does not fault with the pipe locked. */
+int
+pipe_read (struct pipe *pipe, void *buffer, size_t size, bool block) {
+	uint8_t *dst = buffer;
+	size_t done = 0;
+
+	lock_acquire (&pipe->lock);
+	while (block && pipe->head == pipe->tail && pipe->writers > 0) {
+		pipe->read_waiters++;
+		cond_wait (&pipe->readable, &pipe->lock);
+		pipe->read_waiters--;
+	}
+
+	while (done < size && pipe->head != pipe->tail) {
+		struct pipe_slot *slot = &pipe->slots[pipe->head % PIPE_SLOTS];
+		size_t chunk = slot->end - slot->start;
+
+#ifdef VM
+		/* Take a lent frame over whole rather than copy it. */
+		if (slot->frame != NULL && slot->start == 0
+				&& pg_ofs (dst + done) == 0 && size - done >= PGSIZE
+				&& vm_frame_take (dst + done, slot->frame)) {
+			slot->frame = NULL;
+			slot->page = NULL;
+			pipe->head++;
+			done += PGSIZE;
+			continue;
+		}
+#endif
+		if (chunk > size - done)
+			chunk = size - done;
+		memcpy (dst + done, slot->page + slot->start, chunk);
+		slot->start += chunk;
+		done += chunk;
+		if (slot->start == slot->end)
+			pipe_pop_slot (pipe);
+	}
+
+	if (done > 0 && pipe->tail - pipe->head <= PIPE_SLOTS / 2) {
+		if (pipe->write_waiters > 0)
+			cond_broadcast (&pipe->writable, &pipe->lock);
+		waitq_wake (&pipe->pollers);
+	}
+	lock_release (&pipe->lock);
+	return done;
+}
+
+/* Writes SIZE bytes from BUFFER to PIPE, blocking while the ring
+ * is full.  Returns the number of bytes written, which is less
+ * than SIZE only if the last read end was closed part way, or -1
+ * if no read end was left to write to.  Under VM, BUFFER must be
+ * pinned as for pipe_read(). */
+int
+pipe_write (struct pipe *pipe, const void *buffer, size_t size) {
+	const uint8_t *src = buffer;
+	size_t done = 0;
+
+	lock_acquire (&pipe->lock);
+	while (done < size && pipe->readers > 0) {
+		bool whole = pg_ofs (src + done) == 0 && size - done >= PGSIZE;
+		struct pipe_slot *slot;
+		size_t chunk;
+
+#ifdef VM
+		/* Lend the writer's frame rather than copy it. */
+		if (whole && pipe->tail - pipe->head < PIPE_SLOTS) {
+			struct frame *frame = vm_frame_lend ((void *) (src + done));
+
+			if (frame != NULL) {
+				slot = &pipe->slots[pipe->tail++ % PIPE_SLOTS];
+				slot->page = frame->kva;
+				slot->frame = frame;
+				slot->start = 0;
+				slot->end = PGSIZE;
+				done += PGSIZE;
+				continue;
+			}
+		}
+#endif
+		slot = pipe_tail_slot (pipe, whole);
+		if (slot == NULL) {
+			/* Out of room.  Hand over what we have so far before
+			 * going to sleep. */
+			if (pipe->head == pipe->tail)
+				break;
+			if (pipe->read_waiters > 0)
+				cond_broadcast (&pipe->readable, &pipe->lock);
+			waitq_wake (&pipe->pollers);
+			pipe->write_waiters++;
+			cond_wait (&pipe->writable, &pipe->lock);
+			pipe->write_waiters--;
+			continue;
+		}
+
+		chunk = PGSIZE - slot->end;
+		if (chunk > size - done)
+			chunk = size - done;
+		memcpy (slot->page + slot->end, src + done, chunk);
+		slot->end += chunk;
+		done += chunk;
+	}
+
+	if (done > 0) {
+		if (pipe->read_waiters > 0)
+			cond_broadcast (&pipe->readable, &pipe->lock);
+		waitq_wake (&pipe->pollers);
+	}
+	lock_release (&pipe->lock);
+	return done == 0 && size > 0 ? -1 : (int) done;
+}
+
+/* Returns the poll events ready on the read end of PIPE, or on its
+ * write end if WRITER.  If ENTRY is non-null, first queues it to be
+ * woken when that may change. */
+short
+pipe_poll (struct pipe *pipe, bool writer, struct waitq_entry *entry) {
+	short revents = 0;
+
+	lock_acquire (&pipe->lock);
+	if (entry != NULL)
+		waitq_add (&pipe->pollers, entry);
+	if (writer) {
+		if (pipe->readers == 0)
+			revents |= POLLERR;
+		else if (pipe->tail - pipe->head <= PIPE_SLOTS / 2)
+			revents |= POLLOUT;
+	} else {
+		if (pipe->head != pipe->tail)
+			revents |= POLLIN;
+		if (pipe->writers == 0)
+			revents |= POLLHUP;
+	}
+	lock_release (&pipe->lock);
+	return revents;
+}
+
+/* Returns the slot of PIPE that the next write should go to, or a
+ * null pointer if the ring is full or no page is available.  If
+ * WHOLE, the write is a full page and always gets a fresh slot. */
+static struct pipe_slot *
+pipe_tail_slot (struct pipe *pipe, bool whole) {
+	struct pipe_slot *slot;
+	uint8_t *page;
+
+	if (pipe->head != pipe->tail && !whole) {
+		slot = &pipe->slots[(pipe->tail - 1) % PIPE_SLOTS];
+		if (slot->end < PGSIZE)
+			return slot;
+	}
+	if (pipe->tail - pipe->head == PIPE_SLOTS)
+		return NULL;
+
+	if (pipe->spare != NULL) {
+		page = pipe->spare;
+		pipe->spare = NULL;
+	} else {
+		page = palloc_get_page (0);
+		if (page == NULL)
+			return NULL;
+	}
+	slot = &pipe->slots[pipe->tail++ % PIPE_SLOTS];
+	slot->page = page;
+	slot->frame = NULL;
+	slot->start = slot->end = 0;
+	return slot;
+}
+
+/* Retires the oldest slot of PIPE, giving a lent frame back or
+ * keeping its page as the spare if there is none yet. */
+static void
+pipe_pop_slot (struct pipe *pipe) {
+	struct pipe_slot *slot = &pipe->slots[pipe->head++ % PIPE_SLOTS];
+
+#ifdef VM
+	if (slot->frame != NULL) {
+		vm_frame_put (slot->frame);
+		slot->frame = NULL;
+		slot->page = NULL;
+		return;
+	}
+#endif
+	if (pipe->spare == NULL)
+		pipe->spare = slot->page;
+	else
+		palloc_free_page (slot->page);
+	slot->page = NULL;
+}
@@ -0,0 +1,105 @@
+/* poll.c: Waiting for readiness on several objects at once.
+ *
+ * Every pollable object keeps a wait queue.  poll() hangs one entry
+ * per polled object on those queues, all pointing at one semaphore,
+ * and then sleeps on the semaphore until an object wakes it or the
+ * timeout expires.  Entries are queued before readiness is checked,
+ * so an event that arrives in between still ups the semaphore and is
+ * not lost. */
+
+#include "userprog/poll.h"
+#include <debug.h>
+#include "devices/input.h"
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/pipe.h"
+#include "userprog/process.h"
+#include "userprog/syscall.h"
+
+static short poll_one (const struct pollfd *, struct waitq_entry *);
+
+/* Waits until at least one of the NFDS objects in FDS has one of
+ * its requested events ready, or TIMEOUT milliseconds pass.  A
+ * negative TIMEOUT waits forever, and 0 just checks.  Fills in each
+ * REVENTS and returns the number of objects with events, 0 on
+ * timeout, or -1 on failure. */
+int
+poll (struct pollfd *fds, unsigned nfds, int timeout) {
+	struct waitq_entry *entries;
+	struct semaphore sema;
+	struct timer_alarm alarm;
+	int64_t deadline = 0;
+	int ready;
+	unsigned i;
+
+	if (nfds > FDT_COUNT_LIMIT)
+		return -1;
+	check_buffer ((char *) fds, nfds * sizeof *fds, true);
+
+	entries = malloc (nfds * sizeof *entries);
+	if (nfds > 0 && entries == NULL)
+		return -1;
+	sema_init (&sema, 0);
+	for (i = 0; i < nfds; i++)
+		waitq_entry_init (&entries[i], &sema);
+	alarm.sema = NULL;
+	if (timeout > 0) {
+		deadline = timer_ticks ()
+			+ DIV_ROUND_UP ((int64_t) timeout * TIMER_FREQ, 1000);
+		timer_alarm_set (&alarm, deadline, &sema);
+	}
+
+	for (;;) {
+		/* Don't queue anything if we won't sleep. */
+		bool queue = timeout != 0;
+
+		ready = 0;
+		for (i = 0; i < nfds; i++) {
+			fds[i].revents = poll_one (&fds[i], queue ? &entries[i] : NULL);
+			if (fds[i].revents != 0)
+				ready++;
+		}
+		if (ready > 0 || timeout == 0
+				|| (timeout > 0 && timer_ticks () >= deadline))
+			break;
+		sema_down (&sema);
+	}
+
+	timer_alarm_cancel (&alarm);
+	for (i = 0; i < nfds; i++)
+		waitq_remove (&entries[i]);
+	free (entries);
+	return ready;
+}
+
+/* Returns the events ready on the object PFD names, restricted to
+ * those requested plus the ones always reported.  If ENTRY is
+ * non-null, also queues it on the object's wait queue. */
+static short
+poll_one (const struct pollfd *pfd, struct waitq_entry *entry) {
+	short always = POLLERR | POLLHUP | POLLNVAL;
+	struct file *file;
+	short revents;
+
+	if (pfd->events & POLLEXIT)
+		return process_poll_child (pfd->fd, entry)
+			& (pfd->events | always);
+
+	file = find_file_by_fd (pfd->fd);
+	if (file == NULL)
+		revents = POLLNVAL;
+	else if (file == (struct file *) 1)
+		revents = input_poll (entry) ? POLLIN : 0;
+	else if (file == (struct file *) 2)
+		revents = POLLOUT;
+	else if (file_get_pipe (file) != NULL)
+		revents = pipe_poll (file_get_pipe (file),
+				file_is_pipe_writer (file), entry);
+	else
+		/* Disk files never block. */
+		revents = POLLIN | POLLOUT;
+	return revents & (pfd->events | always);
+}
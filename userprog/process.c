@@ -7,12 +7,17 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/tss.h"
+#include "userprog/uring.h"
+#include "userprog/syscall.h"
+#include <poll.h>
+#include <spawn.h>
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
@@ -21,18 +26,108 @@
 #include "threads/synch.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/vma.h"
 #endif
 static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
-struct thread * find_child(int child_tid);
+static void __do_spawn (void *);
+static void __do_vfork (void *);
+static bool duplicate_fds (struct thread *parent);
+static void vfork_release (void);
+static struct exit_record *find_child (int child_tid);
+static int wait_child_start (int tid);
+static void child_started (bool ok);
+static void exit_record_release (struct exit_record *);
+static void orphan_child (struct hash_elem *, void *);
+static uint64_t child_hash (const struct hash_elem *, void *);
+static bool child_less (const struct hash_elem *, const struct hash_elem *,
+		void *);
+
+/* What a parent needs of a child once the child is gone.  Shared by
+ * the two and freed by whichever lets go last, so that an exited
+ * child's thread is destroyed right away instead of lingering until
+ * the parent waits.  The parent finds records by tid in its
+ * `children' table. */
+struct exit_record {
+	int tid;                            /* Child's thread id. */
+	int status;                         /* Exit status, once exited. */
+	bool exited;                        /* Has the child exited? */
+	bool loaded;                        /* Did fork/spawn/vfork succeed? */
+	int refs;                           /* Parent and/or child. */
+	struct semaphore load_sema;         /* Upped once LOADED is known. */
+	struct semaphore exit_sema;         /* Upped when the child exits. */
+	struct waitq pollers;               /* Woken when the child exits. */
+	struct hash_elem elem;              /* In the parent's `children'. */
+};
 /* General process initializer for initd and other process. */
 static void
 process_init (void) {
 	struct thread *current = thread_current ();
 }
 
+/* Gives CHILD, a thread being created by the current thread, an
+ * exit record shared with the current thread.  Returns false if
+ * memory is exhausted. */
+bool
+process_add_child (struct thread *child) {
+	struct thread *curr = thread_current ();
+	struct exit_record *rec;
+
+	if (!curr->children_ready) {
+		if (!hash_init (&curr->children, child_hash, child_less, NULL))
+			return false;
+		curr->children_ready = true;
+	}
+	rec = malloc (sizeof *rec);
+	if (rec == NULL)
+		return false;
+	rec->tid = child->tid;
+	rec->status = -1;
+	rec->exited = false;
+	rec->loaded = false;
+	rec->refs = 2;
+	sema_init (&rec->load_sema, 0);
+	sema_init (&rec->exit_sema, 0);
+	waitq_init (&rec->pollers);
+	hash_insert (&curr->children, &rec->elem);
+	child->exit_record = rec;
+	return true;
+}
+
+/* Drops one reference to REC, freeing it with the last one. */
+static void
+exit_record_release (struct exit_record *rec) {
+	enum intr_level old_level;
+	bool last;
+
+	old_level = intr_disable ();
+	last = --rec->refs == 0;
+	intr_set_level (old_level);
+	if (last)
+		free (rec);
+}
+
+/* hash_destroy() action for a child the parent never waited for. */
+static void
+orphan_child (struct hash_elem *e, void *aux UNUSED) {
+	exit_record_release (hash_entry (e, struct exit_record, elem));
+}
+
+static uint64_t
+child_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct exit_record *rec = hash_entry (e, struct exit_record, elem);
+	return hash_int (rec->tid);
+}
+
+static bool
+child_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct exit_record, elem)->tid
+		< hash_entry (b, struct exit_record, elem)->tid;
+}
+
 /* Starts the first userland program, called "initd", loaded from FILE_NAME.
  * The new thread may be scheduled (and may even exit)
  * before process_create_initd() returns. Returns the initd's
@@ -62,6 +157,7 @@ static void
 initd (void *f_name) {
 #ifdef VM
 	supplemental_page_table_init (&thread_current ()->spt);
+	vma_init (&thread_current ()->vmas);
 #endif
 
 	process_init ();
@@ -79,11 +175,7 @@ process_fork (const char *name, struct intr_frame *if_) {
 	memcpy(&curr->parent_if,if_,sizeof(struct intr_frame));
 	int child_tid = thread_create (name,
 			PRI_DEFAULT, __do_fork, thread_current ());
-	struct thread *t = find_child(child_tid);
-	sema_down(&t->child_load_sema);
-	if(t->exit_status == TID_ERROR){
-		return TID_ERROR;}
-	return child_tid;
+	return wait_child_start(child_tid);
 }
 
 #ifndef VM
@@ -146,7 +238,12 @@ __do_fork (void *aux) {
 	process_activate (current);
 #ifdef VM
 	supplemental_page_table_init (&current->spt);
-	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
+	vma_init (&current->vmas);
+	current->rss_limit = parent->rss_limit;
+	current->heap_start = parent->heap_start;
+	current->brk = parent->brk;
+	if (!vma_copy (&current->vmas, &parent->vmas)
+			|| !supplemental_page_table_copy (&current->spt, &parent->spt))
 		goto error;
 #else
 	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
@@ -158,28 +255,194 @@ __do_fork (void *aux) {
 	 * TODO:       in include/filesys/file.h. Note that parent should not return
 	 * TODO:       from the fork() until this function successfully duplicates
 	 * TODO:       the resources of parent.*/
-	if (parent->fd_idx == FDT_COUNT_LIMIT){
-			goto error;
-		}
-	for (int i = 0; i < FDT_COUNT_LIMIT ;i++){
+	if (!duplicate_fds(parent))
+		goto error;
+	child_started(true);
+	process_init ();
+	/* Finally, switch to the newly created process. */
+	if (succ)
+		do_iret (&if_);
+error:
+	child_started(false);
+	exit(-1);
+}
+
+/* Gives the current thread a copy of PARENT's file descriptor
+ * table.  Returns false if a file could not be duplicated. */
+static bool
+duplicate_fds (struct thread *parent) {
+	struct thread *current = thread_current ();
+
+	if (parent->fd_idx == FDT_COUNT_LIMIT)
+		return false;
+	for (int i = 0; i < FDT_COUNT_LIMIT; i++) {
 		struct file *file = parent->files[i];
-		if (file > 2)
-		{	file = file_duplicate(file);
+		if (file > 2) {
+			file = file_duplicate (file);
 			if (!file)
-				goto error;	
+				return false;
 		}
 		current->files[i] = file;
 	}
-	//printf("name:%s, files0:%d files1:%d\n",thread_current()->name,thread_current()->files[0],thread_current()->files[1]);
 	current->fd_idx = parent->fd_idx;
-	sema_up(&current->child_load_sema);
+	return true;
+}
+
+/* Arguments handed from process_spawn() to the child. */
+struct spawn_info {
+	struct thread *parent;
+	char *cmdline;                      /* Owned by the child. */
+	const struct spawn_action *actions;
+	unsigned n_actions;
+};
+
+/* Starts CMDLINE, a page from palloc_get_page() that this function
+ * takes ownership of, as a new child process, after applying the
+ * N_ACTIONS file descriptor ACTIONS to the child's copy of the fd
+ * table.  The child loads its program straight into a fresh address
+ * space; nothing of the parent's is copied.  Returns the child's
+ * thread id once it has loaded, or TID_ERROR. */
+int
+process_spawn (char *cmdline, const struct spawn_action *actions,
+		unsigned n_actions) {
+	struct spawn_info info;
+	char name[16];
+	int tid;
+
+	info.parent = thread_current ();
+	info.cmdline = cmdline;
+	info.actions = actions;
+	info.n_actions = n_actions;
+
+	strlcpy (name, cmdline, sizeof name);
+	name[strcspn (name, " ")] = '\0';
+	tid = thread_create (name, PRI_DEFAULT, __do_spawn, &info);
+	if (tid == TID_ERROR) {
+		palloc_free_page (cmdline);
+		return TID_ERROR;
+	}
+	return wait_child_start (tid);
+}
+
+/* Applies spawn ACTION to the current thread's fd table. */
+static bool
+apply_spawn_action (const struct spawn_action *action) {
+	switch (action->op) {
+		case SPAWN_CLOSE:
+			close (action->fd);
+			return true;
+		case SPAWN_DUP2:
+			if (find_file_by_fd (action->fd) == NULL
+					|| action->newfd < 0 || action->newfd >= FDT_COUNT_LIMIT)
+				return false;
+			return dup2 (action->fd, action->newfd) == action->newfd;
+		default:
+			return false;
+	}
+}
+
+/* Thread function for process_spawn(). */
+static void
+__do_spawn (void *aux) {
+	struct spawn_info *info = aux;
+	char *cmdline = info->cmdline;
+	struct intr_frame if_;
+	bool success;
+	unsigned i;
+
+#ifdef VM
+	supplemental_page_table_init (&thread_current ()->spt);
+	vma_init (&thread_current ()->vmas);
+#endif
+	success = duplicate_fds (info->parent);
+	for (i = 0; success && i < info->n_actions; i++)
+		success = apply_spawn_action (&info->actions[i]);
+
+	if (success) {
+		if_.ds = if_.es = if_.ss = SEL_UDSEG;
+		if_.cs = SEL_UCSEG;
+		if_.eflags = FLAG_IF | FLAG_MBS;
+		success = load (cmdline, &if_);
+	}
+	palloc_free_page (cmdline);
+
+	/* INFO lives on the parent's stack: done with it after this. */
+	child_started (success);
+	if (!success)
+		exit (-1);
 	process_init ();
-	/* Finally, switch to the newly created process. */
-	if (succ)
-		do_iret (&if_);
-error:
-	sema_up(&current->child_load_sema);
-	exit(-1);
+	do_iret (&if_);
+	NOT_REACHED ();
+}
+
+/* Creates a child that runs in the current process's address
+ * space, starting from the user context in IF_, and blocks until
+ * the child execs or exits and so hands the address space back.
+ * The child signals a good start with `loaded', and wakes us from
+ * vfork_release().
+ * Returns the child's thread id, or TID_ERROR. */
+int
+process_vfork (const char *name, const struct intr_frame *if_) {
+	struct thread *curr = thread_current ();
+
+	memcpy (&curr->parent_if, if_, sizeof (struct intr_frame));
+	return wait_child_start (thread_create (name, PRI_DEFAULT, __do_vfork,
+				curr));
+}
+
+/* Thread function for process_vfork(). */
+static void
+__do_vfork (void *aux) {
+	struct thread *parent = aux;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+
+	memcpy (&if_, &parent->parent_if, sizeof (struct intr_frame));
+	if_.R.rax = 0;
+
+	/* Borrow the parent's address space.  The parent is blocked in
+	 * process_vfork() until vfork_release(). */
+	current->vfork_parent = parent;
+	current->pml4 = parent->pml4;
+#ifdef VM
+	current->spt = parent->spt;
+	current->vmas = parent->vmas;
+	current->stack_bottom = parent->stack_bottom;
+	current->heap_start = parent->heap_start;
+	current->brk = parent->brk;
+#endif
+	process_activate (current);
+
+	if (!duplicate_fds (parent))
+		exit (-1);
+	current->exit_record->loaded = true;
+	process_init ();
+	do_iret (&if_);
+	NOT_REACHED ();
+}
+
+/* If the current thread is a vfork() child, hands the borrowed
+ * address space back to its parent and lets the parent run. */
+static void
+vfork_release (void) {
+	struct thread *curr = thread_current ();
+	struct thread *parent = curr->vfork_parent;
+
+	if (parent == NULL)
+		return;
+#ifdef VM
+	/* Faults taken while borrowing may have grown the table. */
+	parent->spt = curr->spt;
+	parent->vmas = curr->vmas;
+	parent->stack_bottom = curr->stack_bottom;
+	parent->brk = curr->brk;
+	supplemental_page_table_init (&curr->spt);
+	vma_init (&curr->vmas);
+#endif
+	curr->pml4 = NULL;
+	pml4_activate (NULL);
+	curr->vfork_parent = NULL;
+	sema_up (&curr->exit_record->load_sema);
 }
 
 /* Switch the current execution context to the f_name.
@@ -212,6 +475,60 @@ process_exec (void *f_name) {
 }
 
 
+/* Returns the exit record of the current thread's child
+ * CHILD_TID, or a null pointer if there is no such child or it has
+ * already been waited for. */
+static struct exit_record *
+find_child (int child_tid) {
+	struct thread *curr = thread_current ();
+	struct exit_record key;
+	struct hash_elem *e;
+
+	if (!curr->children_ready)
+		return NULL;
+	key.tid = child_tid;
+	e = hash_find (&curr->children, &key.elem);
+	return e != NULL ? hash_entry (e, struct exit_record, elem) : NULL;
+}
+
+/* Waits for the child TID, just created, to report whether it got
+ * going, and returns TID if it did or TID_ERROR if it did not. */
+static int
+wait_child_start (int tid) {
+	struct exit_record *rec;
+
+	if (tid == TID_ERROR)
+		return TID_ERROR;
+	rec = find_child (tid);
+	sema_down (&rec->load_sema);
+	return rec->loaded ? tid : TID_ERROR;
+}
+
+/* Reports to the parent blocked in wait_child_start() whether the
+ * current thread got going, as OK says. */
+static void
+child_started (bool ok) {
+	struct exit_record *rec = thread_current ()->exit_record;
+
+	rec->loaded = ok;
+	sema_up (&rec->load_sema);
+}
+
+/* Returns POLLEXIT if CHILD_TID is a child of the current process
+ * that has exited but has not been waited for, 0 if it is still
+ * running, or POLLNVAL if it is not a child.  If ENTRY is non-null,
+ * first queues it to be woken when that child exits. */
+short
+process_poll_child (int child_tid, struct waitq_entry *entry) {
+	struct exit_record *rec = find_child (child_tid);
+
+	if (rec == NULL)
+		return POLLNVAL;
+	if (entry != NULL)
+		waitq_add (&rec->pollers, entry);
+	return rec->exited ? POLLEXIT : 0;
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
  * it was terminated by the kernel (i.e. killed due to an
  * exception), returns -1.  If TID is invalid or if it was not a
@@ -221,41 +538,26 @@ process_exec (void *f_name) {
  *
  * This function will be implemented in problem 2-2.  For now, it
  * does nothing. */
-struct thread * find_child(int child_tid){
-	struct list_elem *e;
-	struct thread *t = thread_current();
-
-	for (e = list_begin (&t->child_list); e != list_end (&t->child_list);
-			e = list_next (e))
-	{
-		struct thread *c = list_entry(e,struct thread,child_elem);
-		if(c->tid == child_tid)
-			return c;
-	}
-	return NULL;
-}
-
 int
 process_wait (int child_tid UNUSED) {
-	struct thread * t = find_child(child_tid);
-	if(t==NULL) 
-		return -1;	
-	sema_down(&t->wait_sema);
-	int result = t->exit_status; 
-	sema_up(&t->exit_sema);
-	list_remove(&t->child_elem);
-	return result;
+	struct exit_record *rec = find_child (child_tid);
+	int status;
+
+	if (rec == NULL)
+		return -1;
+	sema_down (&rec->exit_sema);
+	status = rec->status;
+	hash_delete (&thread_current ()->children, &rec->elem);
+	exit_record_release (rec);
+	return status;
 }
 
 /* Exit the process. This function is called by thread_exit (). */
 void
 process_exit (void) {
 	struct thread *curr = thread_current();
-	
-	while(!list_empty(&curr->child_list)){
-		struct thread *child = list_entry(list_begin(&curr->child_list),struct thread, child_elem);
-		wait(child->tid);
-	}	
+	struct exit_record *rec = curr->exit_record;
+
 	int i;
 	for (i = 0; i < FDT_COUNT_LIMIT; i++){
 		close(i);
@@ -263,8 +565,21 @@ process_exit (void) {
 	palloc_free_multiple(curr->files,FDT_PAGES);
 	process_cleanup ();
 	file_close(curr->exec_file);
-	sema_up(&curr->wait_sema);
-	sema_down(&curr->exit_sema);
+
+	/* Children we never waited for no longer have anyone to
+	 * report to. */
+	if (curr->children_ready)
+		hash_destroy (&curr->children, orphan_child);
+
+	/* Report to our parent.  After this our thread can be
+	 * destroyed; the record lives on until the parent lets go. */
+	if (rec != NULL) {
+		rec->status = curr->exit_status;
+		rec->exited = true;
+		waitq_wake (&rec->pollers);
+		sema_up (&rec->exit_sema);
+		exit_record_release (rec);
+	}
 }
 
 /* Free the current process's resources. */
@@ -272,7 +587,12 @@ static void
 process_cleanup (void) {
 	struct thread *curr = thread_current ();
 
+	/* A borrowed address space goes back, not away. */
+	vfork_release ();
+	/* The ring lives in the address space being torn down. */
+	uring_release ();
 #ifdef VM
+	vma_kill (&curr->vmas);
 	supplemental_page_table_kill (&curr->spt);
 #endif
 
@@ -298,8 +618,11 @@ process_cleanup (void) {
  * This function is called on every context switch. */
 void
 process_activate (struct thread *next) {
-	/* Activate thread's page tables. */
-	pml4_activate (next->pml4);
+	/* Activate thread's page tables.  A kernel thread touches only
+	 * kernel mappings, which every page table has, so it runs in
+	 * whichever one is loaded. */
+	if (next->pml4 != NULL)
+		pml4_activate (next->pml4);
 
 	/* Set thread's kernel stack for use in processing interrupts. */
 	tss_update (next);
@@ -426,6 +749,10 @@ load (const char *file_name, struct intr_frame *if_) {
 		goto done;
 
 	process_activate (thread_current ());
+#ifdef VM
+	/* load_segment() moves the heap past each segment. */
+	t->heap_start = t->brk = NULL;
+#endif
 	/* Open executable file. */
 
 	file = filesys_open (file_name);
@@ -670,46 +997,6 @@ install_page (void *upage, void *kpage, bool writable) {
 /* From here, codes will be used after project 3.
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
-/* An open file. */
-struct file {
-	struct inode *inode;        /* File's inode. */
-	off_t pos;                  /* Current position. */
-	bool deny_write;            /* Has file_deny_write() been called? */
-};
-bool
-lazy_load_segment (struct page *page, void *aux) {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
-	struct file_info *file_info = (struct file_info *)aux;
-	struct file *file = file_info->file;
-	struct frame *frame = page->frame;
-	int file_size = file_length(file);
-	
-	switch (page->operations->type)
-	{
-		case VM_ANON:
-			// printf("anon page load {%p}\n",page->va);
-			break;
-		case VM_FILE:
-			// printf("file page load {%p}\n",page->va);
-			page->file.file = file;
-			page->file.length = file_info->length;
-			page->file.offset = file_info->offset;
-			break;
-	}
-	// printf("offset : %d\n",file_info->offset);
-	file_seek(file,file_info->offset);
-	int off_set = file_read(file,page->va,file_info->bytes);
-	// printf("off_set:%d\n",off_set);
-	// printf("PGSIZE-off_set:%d\n",PGSIZE-off_set);
-	memset((frame->kva)+(off_set),0,PGSIZE-off_set);
-	// print_spt();
-	// printf("[END] lazy_load_segment \n");
-	pml4_set_dirty(thread_current()->pml4,page->va,0);
-	return true;
-}
-
 /* Loads a segment starting at offset OFS in FILE at address
  * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
  * memory are initialized, as follows:
@@ -729,42 +1016,30 @@ lazy_load_segment (struct page *page, void *aux) {
 static bool
 load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		uint32_t read_bytes, uint32_t zero_bytes, bool writable) {
-	// printf("[START] load_segment start\n");
+	struct file *seg_file = NULL;
+	enum vm_type type = writable ? (VM_ANON | IS_WRITABLE) : VM_ANON;
+
 	ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
-	
-	file_seek(file,ofs);
-	while (read_bytes > 0 || zero_bytes > 0) {
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct file_info *file_info = calloc(sizeof(struct file_info),1);
-		file_info->file = file;
-		file_info->offset = ofs;
-		file_info->bytes = page_read_bytes;
-		void *aux = file_info;
-		enum vm_type type = writable ? (VM_ANON | IS_WRITABLE) : VM_ANON;
-		// VM_ANON : 익명 페이지 -> 파일에서 데이터를 읽어오는 것이 아니라 
-		// 시스템이 관리하는 메모리 영역 
-		if (!vm_alloc_page_with_initializer (type, upage,
-					writable, lazy_load_segment, aux))
-		{	
-			// printf("[FAIL]load_segment.vm_alloc_page_with_initializer\n");
-			free(file_info);
+	/* The whole segment is one area; its pages are created and
+	 * read in as they are faulted on.  BSS pages, with nothing to
+	 * read, are left zero-fill. */
+	if (read_bytes > 0) {
+		seg_file = file_reopen (file);
+		if (seg_file == NULL)
 			return false;
-		}
-		/* Advance. */
-		ofs += page_read_bytes;
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
 	}
-	// printf("[END] load_segment end\n");
+	if (vma_create (&thread_current ()->vmas, upage, read_bytes + zero_bytes,
+				type, writable, seg_file, ofs, read_bytes) == NULL) {
+		if (seg_file != NULL)
+			file_close (seg_file);
+		return false;
+	}
+	if ((uint8_t *) thread_current ()->heap_start < upage + read_bytes + zero_bytes)
+		thread_current ()->heap_start = thread_current ()->brk
+			= upage + read_bytes + zero_bytes;
 	return true;
 }
 
@@ -773,10 +1048,10 @@ static bool
 setup_stack (struct intr_frame *if_) {
 	bool success = false;
 	void *stack_bottom = (void *) (((uint8_t *) USER_STACK) - PGSIZE);
-	//todo writable 저장 필요 type에
-	if(!vm_alloc_page(VM_ANON|IS_STACK|IS_WRITABLE,stack_bottom,true)){
-		// printf("[FAIL] vm_alloc_page\n");
-	}
+	// stack도 하나의 영역으로 두고 아래로 키워 나감
+	if (vma_create (&thread_current ()->vmas, stack_bottom, PGSIZE,
+				VM_ANON | IS_STACK | IS_WRITABLE, true, NULL, 0, 0) == NULL)
+		return false;
 	if(!vm_claim_page(stack_bottom))
 	{
 		// printf("[FAIL]setup_stack vm_claim_page\n");
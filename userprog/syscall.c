@@ -10,6 +10,17 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/palloc.h"
+#include "userprog/uring.h"
+#include "userprog/pipe.h"
+#include "userprog/poll.h"
+#include "devices/input.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/vma.h"
+#endif
+#include <mman.h>
+#include <spawn.h>
+#include <string.h>
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
@@ -30,6 +41,8 @@ struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	struct pipe *pipe;          /* Pipe this is an end of, or NULL. */
+	bool pipe_writer;           /* Write end of PIPE? */
 };
 void
 syscall_init (void) {
@@ -47,15 +60,14 @@ syscall_init (void) {
 void check_addr(char* addr){
 	//세팅은 안됐지만, 페이지는 존재할 때 !!
 #ifdef VM
+	struct thread *t = thread_current ();
+
 	if(!is_user_vaddr(addr)){
 		exit(-1);}
-	struct page *page = spt_find_page(&thread_current()->spt,addr);
-	if(!page){
+	// 아직 page가 없어도 영역 안이면 fault로 만들어짐
+	if(!spt_find_page(&t->spt,addr) && !vma_find(&t->vmas,addr)){
 		exit(-1);}
-	else{
-		return;	
-	}
-	
+	return;
 #endif
 	if(!is_user_vaddr(addr)|| !pml4_get_page(thread_current()->pml4,addr))
 		exit(-1); 
@@ -63,11 +75,16 @@ void check_addr(char* addr){
 
 void check_page(char * addr){
 	#ifdef VM
-	struct page *page = spt_find_page(&thread_current()->spt,addr);
-	if(page ==NULL)
-		exit(-1);
+	struct thread *t = thread_current ();
+	struct page *page = spt_find_page(&t->spt,addr);
+	if(page ==NULL){
+		struct vma *vma = vma_find (&t->vmas, addr);
+		if (vma == NULL || !vma->writable)
+			exit(-1);
+		return;
+	}
 
-	switch (page->operations->type)
+	switch (VM_TYPE (page->operations->type))
 	{
 	case VM_UNINIT:
 		// if(!IS_WRITABLE(page->uninit.type))
@@ -84,6 +101,20 @@ void check_page(char * addr){
 	}
 	#endif
 }
+
+/* Checks every page of the LENGTH bytes at BUFFER, which must also
+ * be writable if WRITABLE.  Without VM, pipe transfers copy with the
+ * pipe lock held, so a bad address has to be caught before they
+ * start. */
+void
+check_buffer(char *buffer, unsigned length, bool writable){
+	char *p;
+	for (p = buffer; p < buffer + length; p = pg_round_down(p) + PGSIZE){
+		check_addr(p);
+		if (writable)
+			check_page(p);
+	}
+}
 /* The main system call interface */
 void
 syscall_handler (struct intr_frame *f UNUSED) {
@@ -140,7 +171,44 @@ syscall_handler (struct intr_frame *f UNUSED) {
 	case SYS_MUNMAP:
 		munmap(f->R.rdi);
 		break;
+	case SYS_MSYNC:
+		f->R.rax = msync((void *) f->R.rdi,f->R.rsi,f->R.rdx);
+		break;
+	case SYS_RSS_LIMIT:
+		rss_limit(f->R.rdi);
+		break;
+	case SYS_RSS_STAT:
+		rss_stat((struct rss_stat *) f->R.rdi);
+		break;
+	case SYS_SBRK:
+		f->R.rax = (uint64_t)sbrk(f->R.rdi);
+		break;
+	case SYS_MADVISE:
+		f->R.rax = madvise((void *) f->R.rdi,f->R.rsi,f->R.rdx);
+		break;
+	case SYS_VMSTAT:
+		vmstat((struct vm_stat *) f->R.rdi,f->R.rsi);
+		break;
 #endif
+	case SYS_URING_SETUP:
+		f->R.rax = uring_setup((struct uring *) f->R.rdi,f->R.rsi);
+		break;
+	case SYS_URING_ENTER:
+		f->R.rax = uring_enter(f->R.rdi);
+		break;
+	case SYS_PIPE:
+		f->R.rax = pipe((int *) f->R.rdi);
+		break;
+	case SYS_SPAWN:
+		f->R.rax = spawn((const char *) f->R.rdi,(char **) f->R.rsi,
+				(const struct spawn_action *) f->R.rdx,f->R.r10);
+		break;
+	case SYS_VFORK:
+		f->R.rax = vfork(f);
+		break;
+	case SYS_POLL:
+		f->R.rax = poll((struct pollfd *) f->R.rdi,f->R.rsi,f->R.rdx);
+		break;
 	default:
 		break;
 	}
@@ -176,6 +244,44 @@ int exec (const char *file){
 	return result;
 }
 
+/* Starts PATH as a child process with the arguments in ARGV, a
+ * null-terminated array whose first element is skipped (the child
+ * gets PATH as its argv[0], as with exec).  ARGV may be null.  The
+ * N_ACTIONS descriptor ACTIONS are applied to the child's copy of
+ * the fd table first.  Unlike fork() then exec(), this never copies
+ * the caller's address space. */
+pid_t spawn (const char *path, char **argv,
+		const struct spawn_action *actions, unsigned n_actions){
+	struct spawn_action acts[SPAWN_MAX_ACTIONS];
+	check_addr((char *) path);
+	if (n_actions > SPAWN_MAX_ACTIONS)
+		return -1;
+	if (n_actions > 0){
+		check_buffer((char *) actions, n_actions * sizeof *actions, false);
+		memcpy(acts, actions, n_actions * sizeof *actions);
+	}
+
+	char *cmdline = palloc_get_page(0);
+	if (cmdline == NULL)
+		return -1;
+	strlcpy(cmdline,path,PGSIZE);
+	if (argv != NULL){
+		for (int i = 1; i < SPAWN_MAX_ARGS; i++){
+			check_addr((char *) &argv[i]);
+			if (argv[i] == NULL)
+				break;
+			check_addr(argv[i]);
+			strlcat(cmdline," ",PGSIZE);
+			strlcat(cmdline,argv[i],PGSIZE);
+		}
+	}
+	return process_spawn(cmdline,acts,n_actions);
+}
+
+pid_t vfork (const struct intr_frame *f){
+	return process_vfork(thread_current()->name,f);
+}
+
 int wait (pid_t child_tid){
 	return process_wait(child_tid);
 }
@@ -234,7 +340,7 @@ int open (const char *file){
 
 int filesize (int fd){
 	struct file *file = find_file_by_fd(fd);
-	if(file < 3)
+	if(file < 3 || file_get_pipe(file))
 		return -1;
 	return file_length(file);
 }
@@ -247,14 +353,129 @@ void pos_update(struct file *file){
 				t->files[i]->pos = file_tell(file);
 	}
 }
+
+#ifdef VM
+/* Pages of a read() or write() buffer pinned at a time. */
+#define RW_CHUNK_PAGES 16
+
+/* Moves the CHUNK bytes at pinned user memory P for a read() or
+ * write() on AUX.  FIRST is true for the first chunk of the call.
+ * Returns the number of bytes moved, or -1 on error. */
+typedef int rw_chunk_func (void *aux, uint8_t *p, unsigned chunk,
+		bool first);
+
+/* Reads LENGTH bytes into user BUFFER, or writes them from BUFFER
+ * if WRITE, by calling RW on AUX RW_CHUNK_PAGES pages at a time.
+ * Each chunk is pinned before RW runs, so that no page fault, and
+ * no swap I/O, happens while RW holds filesys_lock, a pipe's lock
+ * or the console, and so that nothing evicts the pages mid-copy.
+ * Stops at the first short chunk.  Kills the process if BUFFER is
+ * bad. */
+static int
+user_rw_pinned (void *buffer, unsigned length, bool write,
+		rw_chunk_func *rw, void *aux) {
+	uint8_t *p = buffer;
+	int done = 0;
+
+	while (length > 0) {
+		unsigned chunk = RW_CHUNK_PAGES * PGSIZE - pg_ofs(p);
+		size_t cnt, i;
+		int n;
+
+		if (chunk > length)
+			chunk = length;
+		cnt = DIV_ROUND_UP(pg_ofs(p) + chunk, PGSIZE);
+		// read()는 user buffer에 쓰므로 쓰기용으로 pin
+		for (i = 0; i < cnt; i++) {
+			if (vm_pin_user_page(p + i * PGSIZE, !write) == NULL) {
+				while (i-- > 0)
+					vm_unpin_user_page(p + i * PGSIZE);
+				exit(-1);
+			}
+		}
+		n = rw(aux, p, chunk, done == 0);
+		// pipe가 frame을 바꿔 끼웠을 수 있으니 주소로 unpin
+		for (i = 0; i < cnt; i++)
+			vm_unpin_user_page(p + i * PGSIZE);
+
+		if (n < 0)
+			return done > 0 ? done : n;
+		done += n;
+		if (n < (int) chunk)
+			break;
+		p += chunk;
+		length -= chunk;
+	}
+	return done;
+}
+
+static int
+file_read_chunk (void *file, uint8_t *p, unsigned chunk, bool first UNUSED) {
+	int n;
+
+	lock_acquire(&filesys_lock);
+	n = file_read(file, p, chunk);
+	lock_release(&filesys_lock);
+	return n;
+}
+
+static int
+file_write_chunk (void *file, uint8_t *p, unsigned chunk, bool first UNUSED) {
+	int n;
+
+	lock_acquire(&filesys_lock);
+	n = file_write(file, p, chunk);
+	lock_release(&filesys_lock);
+	return n;
+}
+
+/* Only the first chunk waits for data; later ones take what is
+ * there. */
+static int
+pipe_read_chunk (void *pipe, uint8_t *p, unsigned chunk, bool first) {
+	return pipe_read(pipe, p, chunk, first);
+}
+
+static int
+pipe_write_chunk (void *pipe, uint8_t *p, unsigned chunk, bool first UNUSED) {
+	return pipe_write(pipe, p, chunk);
+}
+
+/* Reads keys up to the end of the line, which is not stored. */
+static int
+console_read_chunk (void *aux UNUSED, uint8_t *p, unsigned chunk,
+		bool first UNUSED) {
+	unsigned i;
+
+	for (i = 0; i < chunk; i++) {
+		char ch = input_getc();
+		if (ch == '\n')
+			break;
+		p[i] = ch;
+	}
+	return i;
+}
+
+static int
+console_write_chunk (void *aux UNUSED, uint8_t *p, unsigned chunk,
+		bool first UNUSED) {
+	putbuf((const char *) p, chunk);
+	return chunk;
+}
+#endif
+
 int read (int fd, void *buffer, unsigned length){
 	check_addr(buffer);
 	check_page(buffer);
 
 	struct file *file = find_file_by_fd(fd);
 	int bytes_read = 0;
-	char *ptr = (char *)buffer;
 	if (file == 1){
+#ifdef VM
+		bytes_read = user_rw_pinned(buffer, length, false,
+				console_read_chunk, NULL);
+#else
+		char *ptr = (char *)buffer;
 		for(int i = 0 ; i < length; i++){
 			char ch = input_getc();
 			if (ch == '\n')
@@ -263,15 +484,32 @@ int read (int fd, void *buffer, unsigned length){
 			ptr ++;
 			bytes_read ++;
 		}
+#endif
 	}else{
 		if (file <3)
 			return -1;
+		if (file_get_pipe(file)){
+			if (file_is_pipe_writer(file))
+				return -1;
+#ifdef VM
+			return user_rw_pinned(buffer, length, false, pipe_read_chunk,
+					file_get_pipe(file));
+#else
+			check_buffer(buffer,length,true);
+			return pipe_read(file_get_pipe(file),buffer,length,true);
+#endif
+		}
 
+#ifdef VM
+		bytes_read = user_rw_pinned(buffer, length, false, file_read_chunk,
+				file);
+#else
 		lock_acquire(&filesys_lock);
 		// printf("file_read !!!!\n");
 		bytes_read = file_read(file,buffer,length);
 		// printf("file_read done!!!!%d\n",bytes_read);
 		lock_release(&filesys_lock);
+#endif
 		pos_update(file);	
 	}
 	// printf("read done\n");
@@ -284,16 +522,37 @@ int write (int fd, const void *buffer, unsigned length){
 
 	int byte_write = 0;
 	if (file == 2){ 
+#ifdef VM
+		byte_write = user_rw_pinned((void *) buffer, length, true,
+				console_write_chunk, NULL);
+#else
 		putbuf(buffer,length);
 		byte_write = length;
+#endif
 	}
 	else
 	{
 		if (file < 3)
 			return -1;
+		if (file_get_pipe(file)){
+			if (!file_is_pipe_writer(file))
+				return -1;
+#ifdef VM
+			return user_rw_pinned((void *) buffer, length, true,
+					pipe_write_chunk, file_get_pipe(file));
+#else
+			check_buffer((char *) buffer,length,false);
+			return pipe_write(file_get_pipe(file),buffer,length);
+#endif
+		}
+#ifdef VM
+		byte_write = user_rw_pinned((void *) buffer, length, true,
+				file_write_chunk, file);
+#else
 		lock_acquire(&filesys_lock);
 		byte_write = file_write(file,buffer,length);
 		lock_release(&filesys_lock);
+#endif
 		pos_update(file);
 	}
 	return byte_write;
@@ -301,7 +560,7 @@ int write (int fd, const void *buffer, unsigned length){
 // 파일 편집 위치 변경
 void seek (int fd, unsigned position){
 	struct file *file = find_file_by_fd(fd);
-	if(file < 3)
+	if(file < 3 || file_get_pipe(file))
 		return;
 	file_seek(file,position);
 	pos_update(file);
@@ -309,7 +568,7 @@ void seek (int fd, unsigned position){
 // 파일 위치 반환
 unsigned tell (int fd){
 	struct file *file = find_file_by_fd(fd);
-	if(file < 3)
+	if(file < 3 || file_get_pipe(file))
 		return;
 	return file_tell(file); 
 }
@@ -334,7 +593,12 @@ int dup2(int oldfd, int newfd){
 	if (old_file == new_file)
 		return newfd;
 	
-	if (old_file > 2 ){
+	if (old_file > 2 && file_get_pipe(old_file)){
+		/* Not under filesys_lock: a pipe copy may fault in a file
+		 * page, which takes filesys_lock with the pipe lock held. */
+		close(newfd);
+		thread_current()->files[newfd] = file_duplicate(old_file);
+	}else if (old_file > 2 ){
 		close(newfd);
 		lock_acquire(&filesys_lock);
 		thread_current()->files[newfd] = file_duplicate(old_file);
@@ -346,36 +610,66 @@ int dup2(int oldfd, int newfd){
 	return newfd;
 }
 
+/* Creates a pipe and stores its read end in FDS[0] and its write
+ * end in FDS[1].  Returns 0 on success, -1 on failure. */
+int pipe (int *fds){
+	check_addr((char *) fds);
+	check_page((char *) fds);
+	check_addr((char *) (fds + 1));
+	check_page((char *) (fds + 1));
+
+	struct pipe *p = pipe_create();
+	if (p == NULL)
+		return -1;
+	struct file *rfile = file_open_pipe(p,false);
+	struct file *wfile = file_open_pipe(p,true);
+	if (rfile == NULL || wfile == NULL){
+		file_close(rfile);
+		file_close(wfile);
+		return -1;
+	}
+
+	int rfd = create_fd(rfile);
+	int wfd = rfd == -1 ? -1 : create_fd(wfile);
+	if (wfd == -1){
+		if (rfd != -1)
+			del_fd(rfd);
+		file_close(rfile);
+		file_close(wfile);
+		return -1;
+	}
+	fds[0] = rfd;
+	fds[1] = wfd;
+	return 0;
+}
+
 #ifdef VM
 
 void *
-mmap (void *addr, size_t length, int writable, int fd, unsigned int offset) {
-	struct file *file = find_file_by_fd(fd);
-	struct file *new_file = file_duplicate(file);
-	if( file < 3 ){
-		// printf("[FAIL]file < 3\n");
-		return NULL;}
-	if( length == NULL ){
-		// printf("[FAIL]length is NULL\n");
+mmap (void *addr, size_t length, int flags, int fd, unsigned int offset) {
+	struct file *file;
+	struct file *new_file;
+	void *ret;
+
+	if (flags & MAP_ANONYMOUS)
+		return do_mmap_anon(addr,length,flags);
+	file = find_file_by_fd(fd);
+	if( file < 3 || file_get_pipe(file) ){
 		return NULL;}
-	if( addr == NULL ){
-		// printf("[FAIL]addr is NULL\n");
+	if( length == 0 || addr == NULL || pg_ofs(addr) || pg_ofs(offset) ){
 		return NULL;}
-	if( pg_ofs(addr) ){
-		// printf("[FAIL]addr is not pg_ofs %p\n ",addr);
-		return NULL;}
-	if( !file_length(file) ){
-		// printf("[FAIL]file_length is NULL\n");
-		return NULL;
-	}
-	if(!is_user_vaddr(addr)){
-		return NULL;
-	}
-	if(pg_ofs(offset)) {
+	if( !file_length(file) || !is_user_vaddr(addr) ){
 		return NULL;
 	}
 
-	return do_mmap(addr,length,writable,new_file,offset);
+	// mapping은 fd가 닫혀도 남으므로 file을 따로 엶
+	new_file = file_duplicate(file);
+	if (new_file == NULL)
+		return NULL;
+	ret = do_mmap(addr,length,flags,new_file,offset);
+	if (ret == NULL)
+		file_close (new_file);
+	return ret;
 }
 
 void
@@ -385,4 +679,40 @@ munmap (void *addr) {
 	do_munmap(addr);
 }
 
+int
+msync (void *addr, size_t length, int flags) {
+	return do_msync(addr,length,flags);
+}
+
+void
+rss_limit (size_t pages) {
+	vm_rss_limit(pages);
+}
+
+void
+rss_stat (struct rss_stat *st) {
+	check_buffer((char *) st, sizeof *st, true);
+	vm_rss_stat(st);
+}
+
+void *
+sbrk (intptr_t increment) {
+	return do_sbrk(increment);
+}
+
+int
+madvise (void *addr, size_t length, int advice) {
+	return do_madvise(addr,length,advice);
+}
+
+void
+vmstat (struct vm_stat *st, bool system) {
+	struct vm_stat copy;
+
+	check_buffer((char *) st, sizeof *st, true);
+	// interrupt를 끄고 읽으므로 user memory에는 나중에 복사
+	vm_read_stats(&copy, system);
+	*st = copy;
+}
+
 #endif
\ No newline at end of file
@@ -4,3 +4,6 @@ userprog_SRC += userprog/syscall-entry.S # System call entry.
 userprog_SRC += userprog/syscall.c	# System call handler.
 userprog_SRC += userprog/gdt.c		# GDT initialization.
 userprog_SRC += userprog/tss.c		# TSS management.
+userprog_SRC += userprog/uring.c	# Batched system call ring.
+userprog_SRC += userprog/pipe.c		# Anonymous pipes.
+userprog_SRC += userprog/poll.c		# Readiness multiplexing.
@@ -0,0 +1,184 @@
+/* uring.c: Batched system call submission ring.
+ *
+ * Every system call pays a full syscall_entry -> syscall_handler
+ * round trip.  A process that issues many small requests can
+ * instead queue them in a ring shared with the kernel and ring the
+ * doorbell once; uring_enter() then runs the whole batch inside a
+ * single kernel entry.  See lib/uring.h for the ring layout. */
+
+#include "userprog/uring.h"
+#include <debug.h>
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
+#include "userprog/syscall.h"
+#ifdef VM
+#include "vm/vma.h"
+#endif
+
+/* Kernel side of a registered ring.  Geometry is kept here rather
+ * than read back from user memory, so that the process cannot make
+ * the kernel index outside the region it registered. */
+struct uring_ctx {
+	struct uring *ring;         /* Shared header, in user memory. */
+	struct uring_sqe *sq;       /* Submission array. */
+	struct uring_cqe *cq;       /* Completion array. */
+	uint32_t entries;           /* Number of slots. */
+};
+
+static bool uring_mapped (const struct uring_ctx *ctx);
+static int64_t uring_dispatch (const struct uring_sqe *sqe);
+
+/* Registers RING, which has room for ENTRIES submissions and
+ * completions, as the current process's ring.  ENTRIES must be a
+ * power of 2 no greater than URING_MAX_ENTRIES.  Returns 0 on
+ * success, -1 on failure. */
+int
+uring_setup (struct uring *ring, unsigned entries) {
+	struct thread *curr = thread_current ();
+	struct uring_ctx *ctx;
+	uint8_t *start = (uint8_t *) ring;
+	uint8_t *end;
+	uint8_t *p;
+
+	if (curr->uring != NULL)
+		return -1;
+	if (entries == 0 || entries > URING_MAX_ENTRIES
+			|| (entries & (entries - 1)) != 0)
+		return -1;
+
+	/* The kernel writes the ring, so every page must be a valid
+	 * writable user page. */
+	end = start + URING_SIZE (entries);
+	for (p = pg_round_down (start); p < end; p += PGSIZE) {
+		check_addr ((char *) (p < start ? start : p));
+		check_page ((char *) (p < start ? start : p));
+	}
+
+	ctx = malloc (sizeof *ctx);
+	if (ctx == NULL)
+		return -1;
+	ctx->ring = ring;
+	ctx->entries = entries;
+	ctx->sq = (struct uring_sqe *) (ring + 1);
+	ctx->cq = (struct uring_cqe *) (ctx->sq + entries);
+
+	ring->sq_head = ring->sq_tail = 0;
+	ring->cq_head = ring->cq_tail = 0;
+	ring->entries = entries;
+	curr->uring = ctx;
+	return 0;
+}
+
+/* Consumes up to TO_SUBMIT queued submissions of the current
+ * process's ring, posting a completion for each.  Stops early when
+ * the submission queue runs dry or the completion queue is full.
+ * Returns the number of submissions consumed, or -1 if no ring is
+ * registered or its memory is no longer mapped. */
+int
+uring_enter (unsigned to_submit) {
+	struct uring_ctx *ctx = thread_current ()->uring;
+	struct uring *ring;
+	uint32_t mask;
+	unsigned done = 0;
+
+	if (ctx == NULL || !uring_mapped (ctx))
+		return -1;
+	ring = ctx->ring;
+	mask = ctx->entries - 1;
+
+	while (done < to_submit) {
+		uint32_t head = ring->sq_head;
+		struct uring_sqe sqe;
+		struct uring_cqe *cqe;
+
+		if (head == ring->sq_tail
+				|| ring->cq_tail - ring->cq_head >= ctx->entries)
+			break;
+
+		/* Copy the entry out first: the process may rewrite the
+		 * slot as soon as sq_head moves past it. */
+		sqe = ctx->sq[head & mask];
+		barrier ();
+		ring->sq_head = head + 1;
+
+		cqe = &ctx->cq[ring->cq_tail & mask];
+		cqe->user_data = sqe.user_data;
+		cqe->res = uring_dispatch (&sqe);
+		barrier ();
+		ring->cq_tail++;
+		done++;
+	}
+	return done;
+}
+
+/* Drops the current process's ring registration.  Called when the
+ * address space holding the ring goes away. */
+void
+uring_release (void) {
+	struct thread *curr = thread_current ();
+
+	free (curr->uring);
+	curr->uring = NULL;
+}
+
+/* Returns true if every page of CTX's ring is still a writable
+ * user page.  uring_setup() checked them, but the process may have
+ * unmapped the ring or shrunk the heap under it since.  None of the
+ * requests a batch runs can unmap memory, so checking once per
+ * uring_enter() is enough. */
+static bool
+uring_mapped (const struct uring_ctx *ctx) {
+	struct thread *curr = thread_current ();
+	uint8_t *start = (uint8_t *) ctx->ring;
+	uint8_t *end = start + URING_SIZE (ctx->entries);
+	uint8_t *p;
+
+	for (p = pg_round_down (start); p < end; p += PGSIZE) {
+#ifdef VM
+		struct page *page = spt_find_page (&curr->spt, p);
+		struct vma *vma;
+
+		if (!is_user_vaddr (p))
+			return false;
+		if (page != NULL) {
+			if (!page->writable)
+				return false;
+		} else if ((vma = vma_find (&curr->vmas, p)) == NULL
+				|| !vma->writable)
+			return false;
+#else
+		if (!is_user_vaddr (p) || pml4_get_page (curr->pml4, p) == NULL)
+			return false;
+#endif
+	}
+	return true;
+}
+
+/* Runs a single submission and returns its result, exactly as the
+ * equivalent system call would.  Invalid user pointers terminate
+ * the process, as they do for the direct system calls. */
+static int64_t
+uring_dispatch (const struct uring_sqe *sqe) {
+	switch (sqe->opcode) {
+		case URING_OP_NOP:
+			return 0;
+		case URING_OP_READ:
+			return read (sqe->fd, (void *) sqe->addr, sqe->len);
+		case URING_OP_WRITE:
+			return write (sqe->fd, (const void *) sqe->addr, sqe->len);
+		case URING_OP_OPEN:
+			return open ((const char *) sqe->addr);
+		case URING_OP_CLOSE:
+			close (sqe->fd);
+			return 0;
+#ifdef VM
+		case URING_OP_MMAP:
+			return (int64_t) mmap ((void *) sqe->addr, sqe->len, sqe->flags,
+					sqe->fd, sqe->off);
+#endif
+		default:
+			return -1;
+	}
+}
@@ -1,17 +1,83 @@
-/* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
+/* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page).
+ *
+ * Swap is laid out in clusters of SWAP_CLUSTER slots.  Pages evicted
+ * together are given neighbouring slots and written with one disk
+ * command, and a swap-in reads the in-use slots around the faulting
+ * one in the same command, keeping the neighbours in a small swap
+ * cache that later swap-ins check before going to disk.
+ *
+ * swap_lock protects the slot map and the cache but is not held
+ * across swap I/O, so that processes faulting on different slots
+ * go to disk at the same time.  A faulting page's slot cannot be
+ * read before it has been written, since the page only loses its
+ * frame once the write is done, nor be freed while it is read, since
+ * the page holds a reference to it.  Read-ahead has neither
+ * guarantee: it skips slots still being written, and drops what it
+ * read from a slot that was freed meanwhile, so that the cache never
+ * holds anything but a slot's current contents.  A cached copy is
+ * dropped when its slot is freed, which is the only way a slot's
+ * contents change.
+ *
+ * In front of the disk sits zswap, which keeps pages that compress
+ * well in memory under their slot numbers.  Their disk sectors are
+ * never written, so they are left out of clustered writes and
+ * read-ahead. */
 
 #include "vm/vm.h"
+#include <mman.h>
+#include <round.h>
+#include <string.h>
 #include "devices/disk.h"
 #include "lib/kernel/bitmap.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/vma.h"
+#include "vm/zswap.h"
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
 static bool anon_swap_in (struct page *page, void *kva);
 static bool anon_swap_out (struct page *page);
 static void anon_destroy (struct page *page);
+static void anon_put_slot (int page_no);
+static void swap_io (size_t slot, void *kvas[], size_t cnt, bool write);
+static void swap_read_cluster (size_t slot, void *kva);
+static struct swap_cache_entry *swap_cache_find (size_t slot);
+static void swap_cache_drop (struct swap_cache_entry *);
 
 struct bitmap *swap_map;
 struct lock swap_lock;
+/* Number of pages referring to each swap slot.  A frame shared
+ * copy-on-write goes out to one slot that all its sharers point
+ * to, and so does a swapped-out page copied by fork.  Changed with
+ * interrupts off, so that fork can take a reference without
+ * waiting for swap I/O. */
+static int *swap_refs;
+/* Where the search for the next cluster of free slots starts. */
+static size_t swap_cursor;
+/* Slots being written out.  Protected by swap_lock. */
+static struct bitmap *swap_busy;
+/* Times each slot has been freed, for read-ahead to notice a slot
+ * freed while it was reading it.  Protected by swap_lock. */
+static unsigned *swap_gen;
+
+/* Most pages the swap cache holds. */
+#define SWAP_CACHE_PAGES 32
+
+/* Copy of a swap slot, read ahead of a fault on it. */
+struct swap_cache_entry {
+	size_t slot;
+	void *kva;                  /* Kernel page holding the contents. */
+	struct list_elem elem;      /* In swap_cache. */
+};
+
+/* Swap cache, most recently read first.  Protected by swap_lock. */
+static struct list swap_cache;
+static size_t swap_cache_cnt;
+/* Page that read-ahead of unused slots goes to. */
+static void *swap_scratch;
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations anon_ops = {
@@ -27,7 +93,16 @@ vm_anon_init (void) {
 	swap_disk = disk_get(1,1); // swap disk 
 	size_t swap_size = disk_size(swap_disk) / SECTORS_PER_PAGE;
 	swap_map = bitmap_create(swap_size);
+	swap_refs = calloc(swap_size, sizeof *swap_refs);
+	swap_busy = bitmap_create(swap_size);
+	swap_gen = calloc(swap_size, sizeof *swap_gen);
+	swap_scratch = palloc_get_page(0);
+	if (swap_map == NULL || swap_refs == NULL || swap_busy == NULL
+			|| swap_gen == NULL || swap_scratch == NULL)
+		PANIC ("vm_anon_init: cannot track swap slots");
 	lock_init(&swap_lock);
+	list_init(&swap_cache);
+	zswap_init(swap_size);
 }
 
 /* Initialize the file mapping */
@@ -47,63 +122,359 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 /* Swap in the page by read contents from the swap disk. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
-	// printf("[START] anon_swap_in {%p}\n",page->va);
 	struct anon_page *anon_page = &page->anon;
-	
+	struct swap_cache_entry *entry;
 	int page_no = anon_page->swap_idx;
-	
+
 	lock_acquire(&swap_lock);
 	// 유효한 swap map 인지 확인
 	if(bitmap_test(swap_map,page_no) == false){
 		lock_release(&swap_lock);
 		return false;
 	}
-	lock_release(&swap_lock);
 
-	// 한 페이지의 sector의 개수만큼 sector에서 read
-	for (int i = 0 ; i < SECTORS_PER_PAGE ; i ++)
-	{
-		disk_read(swap_disk, page_no * SECTORS_PER_PAGE + i , page->va + DISK_SECTOR_SIZE * i );
+	// 압축해 둔 slot이나 read-ahead로 이미 읽어 둔 slot이면
+	// disk를 읽지 않음
+	if (!zswap_load(page_no, kva)) {
+		entry = swap_cache_find(page_no);
+		if (entry != NULL)
+			memcpy(kva, entry->kva, PGSIZE);
+		else
+			swap_read_cluster(page_no, kva);
 	}
 
-	// 사용 가능한 swap map으로 변경
-	lock_acquire(&swap_lock);
-	bitmap_set(swap_map,page_no,false);
+	// 마지막 참조였다면 사용 가능한 swap map으로 변경
+	anon_page->swap_idx = -1;
+	anon_put_slot(page_no);
 	lock_release(&swap_lock);
-	// printf("[END] anon_swap_in {%p}\n",page->va);
+	VM_COUNT(page->owner, swap_ins, 1);
 	return true;
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
-	// printf("[START] anon_swap_out {%p}\n",page->va);
-	struct anon_page *anon_page = &page->anon;
+	return anon_swap_out_cluster(&page, 1);
+}
 
-	// 빈 swap slot 찾기
-	int page_no = bitmap_scan(swap_map,0,1,false);
+/* Swaps out the CNT pages in PAGES, each along with every page
+ * sharing its frame, at most SWAP_CLUSTER of them.  They get
+ * neighbouring swap slots if a free run of CNT slots can be found.
+ * Pages that zswap takes stay in memory, and the rest go out in as
+ * few disk commands as their slots allow.  Returns false, having
+ * written nothing, if swap is full. */
+bool
+anon_swap_out_cluster (struct page *pages[], size_t cnt) {
+	size_t slots[SWAP_CLUSTER];
+	void *kvas[SWAP_CLUSTER];
+	size_t start, i, j;
 
-	// 한 페이지의 sector의 개수만큼 sector에 write
-	for (int i = 0 ; i < SECTORS_PER_PAGE ; i ++)
-	{
-		disk_write(swap_disk, page_no * SECTORS_PER_PAGE + i , page->va + DISK_SECTOR_SIZE * i );
-	}
+	ASSERT (cnt > 0 && cnt <= SWAP_CLUSTER);
 
-	// swap_map 셋팅
 	lock_acquire(&swap_lock);
-	bitmap_set(swap_map, page_no, true);
+	// 이전 cluster 바로 뒤부터 연속된 빈 slot을 찾음
+	start = bitmap_scan_and_flip(swap_map, swap_cursor, cnt, false);
+	if (start == BITMAP_ERROR && swap_cursor > 0)
+		start = bitmap_scan_and_flip(swap_map, 0, cnt, false);
+	if (start != BITMAP_ERROR) {
+		for (i = 0; i < cnt; i++)
+			slots[i] = start + i;
+		swap_cursor = start + cnt;
+	} else {
+		/* Swap is too fragmented for a whole cluster; take single
+		 * slots wherever they are. */
+		for (i = 0; i < cnt; i++) {
+			slots[i] = bitmap_scan_and_flip(swap_map, 0, 1, false);
+			if (slots[i] == BITMAP_ERROR) {
+				while (i-- > 0)
+					bitmap_reset(swap_map, slots[i]);
+				lock_release(&swap_lock);
+				return false;
+			}
+		}
+	}
+
+	for (i = 0; i < cnt; i++) {
+		struct frame *frame = pages[i]->frame;
+		struct list_elem *e;
+
+		kvas[i] = frame->kva;
+		swap_refs[slots[i]] = frame->refs;
+		bitmap_mark(swap_busy, slots[i]);
+		// frame을 공유하는 모든 page가 같은 slot을 가리킴
+		// (evict 중인 frame의 page 목록은 바뀌지 않음)
+		for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+				e = list_next (e))
+			list_entry (e, struct page, frame_elem)->anon.swap_idx = slots[i];
+	}
+
 	lock_release(&swap_lock);
 
-	//clear page
-	pml4_clear_page(thread_current()->pml4,page->va);
+	// 압축되지 않은 page 중 연속된 slot끼리 한 번에 write
+	// (swap_lock 없이: 그동안 다른 slot의 swap-in이 진행됨)
+	for (i = 0; i < cnt; i++)
+		if (zswap_store(slots[i], kvas[i]))
+			kvas[i] = NULL;
+		else
+			VM_COUNT(pages[i]->owner, swap_outs, 1);
+	for (i = 0; i < cnt; i = j) {
+		j = i + 1;
+		if (kvas[i] == NULL)
+			continue;
+		while (j < cnt && kvas[j] != NULL && slots[j] == slots[j - 1] + 1)
+			j++;
+		swap_io(slots[i], kvas + i, j - i, true);
+	}
 
-	anon_page->swap_idx = page_no;
-	// printf("[END] anon_swap_out {%p}\n",page->va);
+	lock_acquire(&swap_lock);
+	for (i = 0; i < cnt; i++)
+		bitmap_reset(swap_busy, slots[i]);
+	lock_release(&swap_lock);
 	return true;
 }
 
+/* Reads swap slot SLOT into KVA, along with the other slots of its
+ * cluster that are in use, written and not cached yet, which go
+ * into the swap cache.  Everything is read in one disk command.
+ * Must be called with swap_lock held, which is released during the
+ * read. */
+static void
+swap_read_cluster (size_t slot, void *kva) {
+	size_t first = slot - slot % SWAP_CLUSTER;
+	size_t end = first + SWAP_CLUSTER;
+	void *kvas[SWAP_CLUSTER];
+	unsigned gens[SWAP_CLUSTER];
+	size_t lo = slot, hi = slot + 1;
+	size_t s;
+
+	ASSERT (lock_held_by_current_thread (&swap_lock));
+
+	if (end > bitmap_size(swap_map))
+		end = bitmap_size(swap_map);
+	for (s = first; s < end; s++) {
+		void **dst = &kvas[s - first];
+
+		*dst = NULL;
+		if (s == slot)
+			*dst = kva;
+		else if (swap_refs[s] > 0 && !bitmap_test(swap_busy, s)
+				&& swap_cache_find(s) == NULL && !zswap_contains(s))
+			*dst = palloc_get_page(0);
+		gens[s - first] = swap_gen[s];
+		if (*dst != NULL) {
+			lo = s < lo ? s : lo;
+			hi = s + 1 > hi ? s + 1 : hi;
+		}
+	}
+
+	// 중간의 빈 slot은 버릴 page로 읽음
+	for (s = lo; s < hi; s++)
+		if (kvas[s - first] == NULL)
+			kvas[s - first] = swap_scratch;
+	lock_release(&swap_lock);
+	thread_current()->fault_major = true;
+	swap_io(lo, kvas + (lo - first), hi - lo, false);
+	lock_acquire(&swap_lock);
+
+	for (s = lo; s < hi; s++) {
+		void *page = kvas[s - first];
+		struct swap_cache_entry *entry;
+
+		if (page == kva || page == swap_scratch)
+			continue;
+		// 읽는 동안 해제됐거나 다른 fault가 먼저 cache에 넣은 slot
+		if (swap_gen[s] != gens[s - first] || swap_cache_find(s) != NULL) {
+			palloc_free_page(page);
+			continue;
+		}
+		entry = malloc(sizeof *entry);
+		if (entry == NULL) {
+			palloc_free_page(page);
+			continue;
+		}
+		if (swap_cache_cnt == SWAP_CACHE_PAGES)
+			swap_cache_drop(list_entry (list_back (&swap_cache),
+						struct swap_cache_entry, elem));
+		entry->slot = s;
+		entry->kva = page;
+		list_push_front(&swap_cache, &entry->elem);
+		swap_cache_cnt++;
+	}
+}
+
+/* Reads or, if WRITE, writes the CNT consecutive swap slots from
+ * SLOT, slot SLOT + I from or into page KVAS[I], in one disk
+ * command. */
+static void
+swap_io (size_t slot, void *kvas[], size_t cnt, bool write) {
+	void *sectors[SWAP_CLUSTER * SECTORS_PER_PAGE];
+	size_t i;
+
+	ASSERT (cnt <= SWAP_CLUSTER);
+
+	for (i = 0; i < cnt * SECTORS_PER_PAGE; i++)
+		sectors[i] = (uint8_t *) kvas[i / SECTORS_PER_PAGE]
+			+ DISK_SECTOR_SIZE * (i % SECTORS_PER_PAGE);
+	if (write)
+		disk_writev(swap_disk, slot * SECTORS_PER_PAGE,
+				(const void *const *) sectors, cnt * SECTORS_PER_PAGE);
+	else
+		disk_readv(swap_disk, slot * SECTORS_PER_PAGE, sectors,
+				cnt * SECTORS_PER_PAGE);
+}
+
+/* Returns the swap cache entry for SLOT, or a null pointer if SLOT
+ * is not cached.  Must be called with swap_lock held. */
+static struct swap_cache_entry *
+swap_cache_find (size_t slot) {
+	struct list_elem *e;
+
+	for (e = list_begin (&swap_cache); e != list_end (&swap_cache);
+			e = list_next (e)) {
+		struct swap_cache_entry *entry =
+			list_entry (e, struct swap_cache_entry, elem);
+		if (entry->slot == slot)
+			return entry;
+	}
+	return NULL;
+}
+
+/* Removes ENTRY from the swap cache and frees it.  Must be called
+ * with swap_lock held. */
+static void
+swap_cache_drop (struct swap_cache_entry *entry) {
+	list_remove(&entry->elem);
+	swap_cache_cnt--;
+	palloc_free_page(entry->kva);
+	free(entry);
+}
+
+/* Takes another reference to the swap slot of PAGE, a copy that
+ * fork made of a swapped-out page. */
+void
+anon_fork (struct page *page) {
+	struct anon_page *anon_page = &page->anon;
+
+	enum intr_level old_level;
+
+	if (anon_page->swap_idx < 0)
+		return;
+	// swap I/O 중인 swap_lock을 기다리지 않음
+	old_level = intr_disable();
+	swap_refs[anon_page->swap_idx]++;
+	intr_set_level(old_level);
+}
+
+/* Drops a reference to swap slot PAGE_NO, freeing the slot and any
+ * cached copy of it once no page refers to it.  Must be called with
+ * swap_lock held. */
+static void
+anon_put_slot (int page_no) {
+	struct swap_cache_entry *entry;
+	enum intr_level old_level;
+	bool last;
+
+	ASSERT (lock_held_by_current_thread (&swap_lock));
+
+	old_level = intr_disable();
+	ASSERT (swap_refs[page_no] > 0);
+	last = --swap_refs[page_no] == 0;
+	intr_set_level(old_level);
+	if (!last)
+		return;
+	bitmap_reset(swap_map, page_no);
+	swap_gen[page_no]++;
+	zswap_invalidate(page_no);
+	entry = swap_cache_find(page_no);
+	if (entry != NULL)
+		swap_cache_drop(entry);
+}
+
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	// evict가 끝나기를 기다린 뒤에야 swap_idx가 확정됨
+	vm_drop_frame(page);
+	if (anon_page->swap_idx >= 0) {
+		lock_acquire(&swap_lock);
+		anon_put_slot(anon_page->swap_idx);
+		lock_release(&swap_lock);
+	}
+}
+
+/* Do the mmap of MAP_ANONYMOUS memory.  Maps LENGTH bytes of zeros
+ * at ADDR, or if ADDR is null at an address the kernel picks below
+ * the stack's reach and above the heap, as one area whose pages are
+ * created on first touch.  FLAGS are the MAP_* flags of <mman.h>;
+ * MAP_SHARED is not supported.  Returns the address, or a null
+ * pointer if the range is invalid, overlaps an existing mapping, or
+ * no free range is big enough. */
+void *
+do_mmap_anon (void *addr, size_t length, int flags) {
+	struct thread *t = thread_current ();
+	enum vm_type type = VM_ANON;
+	bool writable = (flags & MAP_WRITABLE) != 0;
+	struct vma *vma;
+
+	if (length == 0 || length > KERN_BASE || (flags & MAP_SHARED))
+		return NULL;
+	length = ROUND_UP (length, PGSIZE);
+	if (addr == NULL) {
+		void *floor = t->brk != NULL ? pg_round_up (t->brk) : (void *) PGSIZE;
+		addr = vma_find_free (&t->vmas, length, floor, (void *) STACK_LIMIT);
+		if (addr == NULL)
+			return NULL;
+	} else if (pg_ofs (addr) || !is_user_vaddr (addr)
+			|| length > KERN_BASE - (uint64_t) addr)
+		return NULL;
+
+	if (writable)
+		type |= IS_WRITABLE;
+	vma = vma_create (&t->vmas, addr, length, type, writable, NULL, 0, 0);
+	if (vma == NULL)
+		return NULL;
+	vma->mmap = true;
+	if (flags & MAP_POPULATE)
+		vma_populate (vma);
+	return addr;
+}
+
+/* Do the sbrk.  Moves the end of the current process's heap by
+ * INCREMENT bytes and returns the old end, or (void *) -1 if the
+ * heap would run into another area or below its start.  The heap
+ * is one writable anonymous area from the page past the highest ELF
+ * segment to the page holding its end, whose pages are created on
+ * first touch; shrinking it destroys the pages it gives up. */
+void *
+do_sbrk (intptr_t increment) {
+	struct thread *t = thread_current ();
+	uint8_t *start = t->heap_start, *old = t->brk, *new = old + increment;
+	uint8_t *old_end, *new_end;
+	struct vma *heap;
+
+	if (start == NULL || (increment < 0 ? new < start
+				: (uint64_t) increment > KERN_BASE - (uint64_t) old))
+		return (void *) -1;
+	old_end = pg_round_up (old);
+	new_end = pg_round_up (new);
+	heap = old_end > start ? vma_find (&t->vmas, start) : NULL;
+
+	if (new_end > old_end) {
+		if (heap == NULL)
+			heap = vma_create (&t->vmas, start, new_end - start,
+					VM_ANON | IS_WRITABLE, true, NULL, 0, 0);
+		else if (!vma_grow_up (&t->vmas, heap, new_end))
+			heap = NULL;
+		if (heap == NULL)
+			return (void *) -1;
+	} else if (new_end < old_end) {
+		if (new_end == start)
+			vma_destroy (&t->vmas, heap);
+		else
+			vma_shrink (heap, new_end);
+	}
+	t->brk = new;
+	return old;
 }
@@ -1,12 +1,16 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <mman.h>
 #include "vm/vm.h"
+#include "vm/vma.h"
+#include "filesys/page_cache.h"
 #include "threads/pte.h"
 #include "threads/vaddr.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
 static void file_backed_destroy (struct page *page);
+static void file_backed_write_back (struct page *page);
 
 
 /* DO NOT MODIFY this struct */
@@ -43,17 +47,18 @@ file_backed_swap_in (struct page *page, void *kva) {
 	off_t offset = file_page->offset;
 	// printf("offset : %d \n",offset);
 	// printf("file_size : %d \n",file_length(file));
-	size_t length = (file_length(file) - offset) > PGSIZE ? PGSIZE : (file_length(file) - offset);
+	size_t length = file_page->length;
 	int check;
 
-	lock_acquire(&filesys_lock);
-	if((check = file_read_at(file,kva,length,offset))!= length){
-		lock_release(&filesys_lock);
+	// shared mapping은 page cache의 frame을 그대로 매핑함
+	if (IS_SHARED (file_page->type) && page->frame->cache != NULL)
+		return true;
+	// page cache가 알아서 lock을 잡음
+	if((check = file_read_at(file,kva,length,offset))!= (int) length){
 		printf("length : %d , check : %d \n",length,check);
 		PANIC("todo");
 		return false;
 	}
-	lock_release(&filesys_lock);
 	if(length < PGSIZE){
 		memset(kva+length,0,PGSIZE-length);
 	}
@@ -66,119 +71,124 @@ static bool
 file_backed_swap_out (struct page *page) {
 	// printf("[START] file_backed_swap_out %p\n",page->va);
 	struct file_page *file_page UNUSED = &page->file;
-	void *addr = page->va;
-	struct thread *t = thread_current();
 
-	if(IS_WRITABLE(page->file.type))
+	file_backed_write_back (page);
+	// printf("[END] file_backed_swap_out %p\n",page->va);
+	return true;
+}
+
+/* Writes PAGE's frame back to its file if the mapping is writable
+ * and a page sharing the frame has dirtied it since it was last
+ * written.  The data goes into the page cache if the file's page is
+ * cached there, without taking filesys_lock or a new frame, since
+ * the evictor calls this.  A page mapping a cache frame has nothing
+ * of its own to write: the cache frame carries its writes. */
+static void
+file_backed_write_back (struct page *page) {
+	if (page->frame->cache != NULL)
+		return;
+	if(IS_WRITABLE(page->file.type) && vm_frame_test_and_clean (page->frame))
 	{	
 		struct file *file = page->file.file;
 		int length = page->file.length;
-		lock_acquire(&filesys_lock);
-		file_write_at (file,page->frame->kva,length,page->file.offset);
-		lock_release(&filesys_lock);
+		page_cache_write_around (file_get_inode (file), page->frame->kva,
+				length, page->file.offset);
+		VM_COUNT (page->owner, writebacks, 1);
 	}
-	lock_acquire(&filesys_lock);
-	list_remove(&page->frame->elem);
-	lock_release(&filesys_lock);
-	pml4_clear_page(t->pml4,addr);
-	
-	page->frame->page = NULL;
-	page->frame = NULL;
-	// printf("[END] file_backed_swap_out %p\n",page->va);
-	return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
 	struct file_page *file_page UNUSED = &page->file;
-	if (page->frame) {
-		file_backed_swap_out(page);
+	struct frame *frame = vm_frame_pin (page);
+
+	if (frame) {
+		file_backed_write_back(page);
+		vm_frame_unpin(frame);
+		vm_drop_frame(page);
 	}
 }
 
-/* Do the mmap */
+/* Do the mmap.  Maps LENGTH bytes of FILE from OFFSET at ADDR as
+ * one area, taking over the caller's reference to FILE.  FLAGS are
+ * the MAP_* flags of <mman.h>.  No page is created until it is
+ * touched, unless MAP_POPULATE asks for all of them up front.  With
+ * MAP_SHARED the pages map the file's page cache frames, shared
+ * with every other shared mapping of the file and with read() and
+ * write(); otherwise each page is a private copy written back on
+ * munmap() and eviction.
+ * Returns ADDR, or a null pointer if the range is invalid or
+ * overlaps an existing mapping. */
 void *
-do_mmap (void *addr, size_t length, int writable,
+do_mmap (void *addr, size_t length, int flags,
 		struct file *file, off_t offset) {
-	// printf("[START]do_mmap!\n");
-	if( is_kernel_vaddr(addr) || addr == KERN_BASE - PGSIZE ){
-		return NULL;
-	}
+	bool writable = (flags & MAP_WRITABLE) != 0;
+	struct vma *vma;
+	size_t file_size = file_length(file);
+	size_t file_bytes = 0;
 
-	// 이미 할당된 페이지 인지 확인 
-	if(spt_find_page(&thread_current()->spt, addr))
-	{	
+	if (addr == NULL || pg_ofs (addr) || length == 0
+			|| !is_user_vaddr (addr) || length > KERN_BASE - (uint64_t) addr)
+		return NULL;
+	length = ROUND_UP (length, PGSIZE);
+	if (length > KERN_BASE - (uint64_t) addr)
 		return NULL;
-	}
-
-	size_t file_size = file_length(file);
-	size_t read_bytes, zero_bytes;
 
-	read_bytes = length > file_size - offset ? length : file_size - offset;
-	zero_bytes = (ROUND_UP (read_bytes, PGSIZE)
-								- read_bytes);
+	// 파일 끝을 넘는 부분은 0으로 채움
+	if ((size_t) offset < file_size)
+		file_bytes = file_size - offset < length ? file_size - offset : length;
 	enum vm_type type = writable ? (VM_FILE | IS_WRITABLE) : VM_FILE;
-	void *ret = addr;
-	while ( read_bytes > 0 || zero_bytes > 0 ) {
-		// printf("file_size : %d\n",file_size);
-		// printf("addr : %p\n",addr);
-		// printf("offset :%d \n",offset); 
-		size_t page_read_bytes = read_bytes > PGSIZE ? PGSIZE : read_bytes;
-		size_t file_read_bytes = file_size > 0 ? file_size : 0;
-		file_read_bytes = file_size > PGSIZE ? PGSIZE : file_size;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-		// printf("file_read_bytes : %d\n",file_read_bytes);
-		struct file_info *file_info = calloc(sizeof(struct file_info),1);
-		file_info->file = file;
-		file_info->offset = offset;
-		file_info->length = length;
-		// 실제 파일 바이트
-		file_info->bytes = file_read_bytes;
-		if(!vm_alloc_page_with_initializer(type, addr,
-					writable, lazy_load_segment,file_info))
-		{
-			printf("[FAIL] do_mmap.vm_alloc_page_with_initializer\n");
-			free(file_info);
-			return NULL;
-		}
-		offset += page_read_bytes;
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		file_size -= file_read_bytes;
-		addr += PGSIZE;
+	if (flags & MAP_SHARED)
+		type |= IS_SHARED;
+	vma = vma_create (&thread_current ()->vmas, addr, length, type, writable,
+			file, offset, file_bytes);
+	if (vma == NULL)
+		return NULL;
+	vma->mmap = true;
+	if (flags & MAP_POPULATE)
+		vma_populate (vma);
+	return addr;
+}
+
+/* Do the msync.  Writes back the dirty pages of the file mappings
+ * in the LENGTH bytes at ADDR, which must be page-aligned and all
+ * mapped, to the page cache, and from there to disk before
+ * returning if FLAGS is MS_SYNC.  With MS_ASYNC kworkerd writes
+ * them out later.  Returns 0 if successful, -1 otherwise. */
+int
+do_msync (void *addr, size_t length, int flags) {
+	struct rb_tree *vmas = &thread_current ()->vmas;
+	uint8_t *start = addr, *end, *va;
+	struct vma *vma;
+
+	if (pg_ofs (addr) || (flags != MS_ASYNC && flags != MS_SYNC)
+			|| !is_user_vaddr (addr) || length > KERN_BASE - (uint64_t) addr)
+		return -1;
+	end = start + ROUND_UP (length, PGSIZE);
+
+	/* The whole range must be mapped. */
+	for (va = start; va < end; va = vma->end)
+		if ((vma = vma_find (vmas, va)) == NULL)
+			return -1;
+
+	for (va = start; va < end; va = vma->end) {
+		vma = vma_find (vmas, va);
+		vma_sync (vma, va, end < (uint8_t *) vma->end ? end : vma->end,
+				flags == MS_SYNC);
 	}
-	// printf("[END] do_mmap.\n");
-	return ret;
+	return 0;
 }
 
-/* Do the munmap */
+/* Do the munmap.  ADDR must be the start of a mapping made by
+ * mmap(); anything else is ignored. */
 void
 do_munmap (void *addr) {
-	// printf("[START]do_munmap start\n");
-	struct thread *t = thread_current();
-	struct page *page = spt_find_page(&t->spt,addr);
-	struct file *file = page->file.file;
-	int length = page->file.length;
+	struct rb_tree *vmas = &thread_current ()->vmas;
+	struct vma *vma = vma_find (vmas, addr);
 
-	if(IS_WRITABLE(page->file.type))
-	{	
-		// printf("write before\n");
-		lock_acquire(&filesys_lock);
-		file_write_at (file,page->frame->kva,length,page->file.offset);
-		lock_release(&filesys_lock);
-	}	
-	
-	int page_cnt = ( length -1 ) / PGSIZE +1;
-	for (int i = 0 ; i < page_cnt ; i ++ ){
-		page = spt_find_page(&t->spt,addr+(PGSIZE * i));
-		if (page == NULL){
-			break;
-		}
-		spt_remove_page(&t->spt,page);
-	}
-	lock_acquire(&filesys_lock);
-	file_close(file);
-	lock_release(&filesys_lock);
-	// printf("[END]do_munmap end\n");
+	if (vma == NULL || vma->start != addr || !vma->mmap)
+		return;
+	// 만들어진 page만 지우면서 dirty page는 file에 씀
+	vma_destroy (vmas, vma);
 }
@@ -1,13 +1,56 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <mman.h>
+#include <string.h>
+#include "devices/timer.h"
 #include "threads/malloc.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "vm/vma.h"
+#include "filesys/page_cache.h"
 #include "include/threads/vaddr.h"
 #include "threads/mmu.h"
+#include "intrinsic.h"
 
-#define STACK_LIMIT 	(USER_STACK - (1 <<20))
 struct list frame_list;
+struct vm_stat vm_stats;
+/* Next frame in frame_list for vm_get_victim() to look at. */
+static struct list_elem *clock_hand;
+/* Broadcast on frame_lock whenever an eviction finishes. */
+static struct condition frame_evicted;
+
+/* kswapd starts evicting when fewer than kswapd_low user pages are
+ * free and stops once kswapd_high are.  Both scale with the user
+ * pool. */
+static size_t kswapd_low, kswapd_high;
+static struct semaphore kswapd_sema;    /* Upped to wake kswapd. */
+static bool kswapd_awake;               /* Woken and not done yet? */
+static void kswapd (void *aux);
+
+/* Frame of zeros shared read-only by every anonymous page that has
+ * been read but never written.  It is not in the frame table, so it
+ * is never evicted, and it is never freed. */
+static struct frame zero_frame;
+
+/* ksmd wakes every KSM_INTERVAL ticks and looks at the next
+ * KSM_BATCH frames of the frame table, merging those whose contents
+ * match a frame it saw earlier in the same pass. */
+#define KSM_INTERVAL (TIMER_FREQ / 10)
+#define KSM_BATCH 32
+static struct list_elem *ksm_hand;      /* Next frame to look at. */
+static struct hash ksm_table;           /* Frames seen this pass. */
+static uint64_t zero_checksum;          /* Checksum of a zero page. */
+static long long ksm_merged;            /* Frames freed by merging. */
+static long long ksm_zero_merged;       /* ...into the zero frame. */
+static long long ksm_split;             /* Copies of merged frames. */
+static void ksmd (void *aux);
+static hash_hash_func ksm_hash;
+static hash_less_func ksm_less;
+static hash_action_func ksm_unhash;
+static void ksm_scan_frame (struct frame *frame);
+static bool ksm_mergeable (struct frame *frame);
+static bool ksm_merge (struct frame *frame, struct frame *into);
+static void frame_write_protect (struct frame *frame);
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -28,13 +71,28 @@ void
 vm_init (void) {
 	vm_anon_init ();
 	vm_file_init ();
-#ifdef EFILESYS  /* For project 4 */
-	pagecache_init ();
-#endif
 	register_inspect_intr ();
 	list_init(&frame_list);
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
+	lock_init (&frame_lock);
+	cond_init (&frame_evicted);
+
+	kswapd_low = palloc_free_count (PAL_USER) / 64 + 8;
+	kswapd_high = kswapd_low * 2;
+	sema_init (&kswapd_sema, 0);
+	zero_frame.kva = palloc_get_page (PAL_ZERO);
+	if (zero_frame.kva == NULL)
+		PANIC ("vm_init: cannot allocate zero frame");
+	list_init (&zero_frame.pages);
+	zero_checksum = hash_bytes (zero_frame.kva, PGSIZE);
+	if (!hash_init (&ksm_table, ksm_hash, ksm_less, NULL))
+		PANIC ("vm_init: cannot allocate ksm table");
+	if (thread_create ("kswapd", PRI_DEFAULT, kswapd, NULL) == TID_ERROR)
+		PANIC ("vm_init: cannot start kswapd");
+	if (thread_create ("ksmd", PRI_MIN, ksmd, NULL) == TID_ERROR)
+		PANIC ("vm_init: cannot start ksmd");
+	page_cache_init ();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -54,7 +112,27 @@ page_get_type (struct page *page) {
 /* Helpers */
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
-static struct frame *vm_evict_frame (void);
+static struct frame *vm_shared_frame (struct page *page);
+static size_t vm_evict_frames (struct frame *frames[], size_t cnt);
+static void vm_write_out (struct frame *frames[], size_t n);
+static void frame_isolate (struct frame *frame);
+static struct thread *rss_owner (void);
+static bool rss_has_room (struct thread *owner, size_t cnt);
+static void vm_rss_trim (struct thread *owner);
+static void frame_add_page (struct frame *frame, struct page *page);
+static void frame_detach (struct frame *frame);
+static void frame_lock_page (struct page *page);
+static void frame_remove_page (struct page *page);
+static struct list_elem *clock_next (struct list_elem *);
+static void frame_list_insert (struct frame *frame);
+static void frame_list_remove (struct frame *frame);
+static bool frame_is_accessed (struct frame *frame, bool clear);
+static bool frame_is_clean (struct frame *frame);
+static bool spt_copy_page (struct hash *dst, struct page *page);
+static bool vm_claim_on_fault (struct page *page, bool write);
+static bool vm_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present);
+static void vm_promote (struct page *page);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -85,6 +163,9 @@ bool
 			uninit_new(new_page,upage,init,type,aux,file_backed_initializer);
 			break;
 		}
+		new_page->pml4 = thread_current ()->pml4;
+		new_page->owner = rss_owner ();
+		new_page->writable = writable;
 		
 		// 2.보조 페이지 테이블에 삽입
 		if(!spt_insert_page(spt,new_page))
@@ -129,91 +210,823 @@ spt_remove_page (struct hash *spt, struct page *page) {
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Get the struct frame, that will be evicted.
+ *
+ * This is the enhanced second-chance clock.  The hand sweeps the
+ * global frame table and survives between calls.  The first sweep
+ * looks for a frame that is neither recently used nor dirty,
+ * changing nothing.  The second takes any frame that is not
+ * recently used, clearing the accessed bits of the ones it passes
+ * to give them a second chance.  If both fail, every bit is clear
+ * by then and repeating them once must succeed.  Pinned frames are
+ * never chosen.
+ *
+ * The victim leaves the frame table marked as being evicted, with
+ * every page sharing it unmapped, so that nobody can write to it
+ * while it is written out.  Returns a null pointer if every frame
+ * is pinned.  Must be called with frame_lock held. */
 static struct frame *
 vm_get_victim (void) {
-	struct frame *victim = NULL;
-	
-	struct thread *t = thread_current();
+	size_t n = list_size (&frame_list);
+	int round;
+	size_t i;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
 
+	if (clock_hand == NULL || clock_hand == list_end (&frame_list))
+		clock_hand = list_begin (&frame_list);
+	for (round = 0; round < 4; round++) {
+		bool want_clean = round % 2 == 0;
+
+		for (i = 0; i < n; i++) {
+			struct frame *frame = list_entry (clock_hand, struct frame, elem);
+
+			clock_hand = clock_next (clock_hand);
+			if (frame->pins > 0)
+				continue;
+			if (want_clean ? !frame_is_accessed (frame, false)
+						&& frame_is_clean (frame)
+					: !frame_is_accessed (frame, true)) {
+				frame_isolate (frame);
+				return frame;
+			}
+		}
+	}
+	return NULL;
+}
+
+/* Takes FRAME out of the frame table to be evicted, marked as being
+ * evicted and with every page sharing it unmapped.  Must be called
+ * with frame_lock held. */
+static void
+frame_isolate (struct frame *frame) {
 	struct list_elem *e;
 
-	// for(e = list_begin(&frame_list) ; e != list_end(&frame_list); e = list_next(e)){
-	// 	victim = list_entry(e,struct frame, elem);
-	// 	// pte가 엑세스 된 경우
-	// 	if(!pml4_is_accessed(t->pml4,victim->page->va)){
-	// 		// 엑세스 되지 않은 pte는 바로 반환
-	// 		list_remove(e);
-	// 		return victim;
-	// 	}
-	// 	// printf("accessed va %p\n",victim->page->va);
-	// }
-	
-	// 못 찾은 경우
-	for(e = list_begin(&frame_list); e != list_end(&frame_list); e = list_next(e)){
-		victim = list_entry(e,struct frame, elem);
-		// pte가 엑세스 된 경우
-		if(pml4_is_accessed(t->pml4,victim->page->va)){
-			break;
+	frame_list_remove (frame);
+	frame->evicting = true;
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		pml4_clear_page (p->pml4, p->va);
+	}
+}
+
+/* Returns the frame after E in the frame table, wrapping around. */
+static struct list_elem *
+clock_next (struct list_elem *e) {
+	e = list_next (e);
+	return e == list_end (&frame_list) ? list_begin (&frame_list) : e;
+}
+
+/* Adds FRAME to the frame table just behind the clock hand, so
+ * that it is the last frame the hand gets to. */
+static void
+frame_list_insert (struct frame *frame) {
+	if (clock_hand == NULL || clock_hand == list_end (&frame_list))
+		list_push_back (&frame_list, &frame->elem);
+	else
+		list_insert (clock_hand, &frame->elem);
+}
+
+/* Removes FRAME from the frame table, moving the clock hand and
+ * ksmd's hand off it first, and from ksmd's table. */
+static void
+frame_list_remove (struct frame *frame) {
+	if (clock_hand == &frame->elem)
+		clock_hand = list_next (clock_hand);
+	if (ksm_hand == &frame->elem)
+		ksm_hand = list_next (ksm_hand);
+	if (frame->ksm_hashed) {
+		hash_delete (&ksm_table, &frame->ksm_elem);
+		frame->ksm_hashed = false;
+	}
+	list_remove (&frame->elem);
+}
+
+/* Returns true if any page sharing FRAME has accessed it, or the
+ * page cache has since the clock last looked, and if CLEAR, clears
+ * the accessed bits. */
+static bool
+frame_is_accessed (struct frame *frame, bool clear) {
+	struct list_elem *e;
+	bool accessed = false;
+
+	if (frame->cache != NULL && frame->cache->page_cache.accessed) {
+		if (!clear)
+			return true;
+		accessed = true;
+		frame->cache->page_cache.accessed = false;
+	}
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		if (pml4_is_accessed (p->pml4, p->va)) {
+			accessed = true;
+			if (!clear)
+				break;
+			pml4_set_accessed (p->pml4, p->va, false);
 		}
 	}
-	// 엑세스 비트를 0으로 변경
-	pml4_set_accessed(t->pml4,victim->page->va,0);
-	
-	list_remove(e);
-	
-	return victim;
+	return accessed;
+}
+
+/* Returns true if FRAME can be evicted without writing it out,
+ * that is, if it holds a file-backed page nobody has dirtied.
+ * Anonymous pages always have to go to swap. */
+static bool
+frame_is_clean (struct frame *frame) {
+	struct list_elem *e;
+
+	if (frame->cache != NULL && frame->cache->page_cache.dirty)
+		return false;
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		if (VM_TYPE (p->operations->type) != VM_FILE
+				|| pml4_is_dirty (p->pml4, p->va))
+			return false;
+	}
+	return true;
 }
   
-/* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
-static struct frame *
-vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	swap_out(victim->page);
-	return victim;
+/* Evicts up to CNT frames, at most SWAP_CLUSTER, and stores them
+ * in FRAMES, no longer in the frame table and with no pages.
+ * Returns how many were evicted, which is less than CNT only if
+ * the rest of the frames are pinned.  frame_lock is only held to
+ * pick the victims, not while they are written out. */
+static size_t
+vm_evict_frames (struct frame *frames[], size_t cnt) {
+	size_t n;
+
+	ASSERT (cnt <= SWAP_CLUSTER);
+
+	lock_acquire (&frame_lock);
+	for (n = 0; n < cnt; n++)
+		if ((frames[n] = vm_get_victim ()) == NULL)
+			break;
+	lock_release (&frame_lock);
+
+	vm_write_out (frames, n);
+	return n;
+}
+
+/* Writes out the N frames in FRAMES, at most SWAP_CLUSTER, which
+ * frame_isolate() has taken out of the frame table, and detaches
+ * their pages. */
+static void
+vm_write_out (struct frame *frames[], size_t n) {
+	struct page *anon[SWAP_CLUSTER];
+	size_t anon_cnt = 0;
+	size_t i;
+
+	ASSERT (n <= SWAP_CLUSTER);
+
+	/* Swapping out one page swaps out every page sharing it; a
+	 * page cache frame goes out as its cache page, which shared
+	 * mappings fault back in from the cache.  Anonymous victims go
+	 * out together, to neighbouring swap slots in one disk
+	 * command. */
+	for (i = 0; i < n; i++) {
+		struct page *page = frames[i]->cache != NULL ? frames[i]->cache
+			: list_entry (list_front (&frames[i]->pages),
+					struct page, frame_elem);
+
+		if (frames[i]->cache != NULL)
+			VM_COUNT (NULL, cache_evictions, 1);
+		else if (VM_TYPE (page->operations->type) == VM_ANON)
+			VM_COUNT (page->owner, anon_evictions, 1);
+		else
+			VM_COUNT (page->owner, file_evictions, 1);
+		if (VM_TYPE (page->operations->type) == VM_ANON)
+			anon[anon_cnt++] = page;
+		else if (!swap_out (page))
+			PANIC ("vm_evict_frames: cannot swap out %p", page->va);
+	}
+	if (anon_cnt > 0 && !anon_swap_out_cluster (anon, anon_cnt))
+		PANIC ("vm_evict_frames: out of swap space");
+
+	lock_acquire (&frame_lock);
+	for (i = 0; i < n; i++) {
+		frame_detach (frames[i]);
+		if (frames[i]->cache != NULL)
+			vm_dealloc_page (frames[i]->cache);
+		frames[i]->evicting = false;
+	}
+	cond_broadcast (&frame_evicted, &frame_lock);
+	lock_release (&frame_lock);
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
-static struct frame *
+ * space.
+ *
+ * Normally kswapd keeps enough pages free that palloc() succeeds
+ * right away; evicting here is the fallback when it falls behind.
+ * The frame comes back pinned, for the caller to unpin once it has
+ * mapped and filled it. */
+struct frame *
 vm_get_frame (void) {
-	struct frame *frame = calloc(sizeof(struct frame),1); 
-	frame->kva = palloc_get_page(PAL_ZERO | PAL_USER);
-	
-	if(frame->kva == NULL){
-		free(frame);
-		frame = vm_evict_frame();
+	struct frame *frame;
+	void *kva = palloc_get_page(PAL_ZERO | PAL_USER);
+
+	if (kva != NULL) {
+		frame = malloc (sizeof *frame);
+		if (frame == NULL)
+			PANIC ("vm_get_frame: out of kernel memory");
+		frame->kva = kva;
+	} else {
+		if (vm_evict_frames (&frame, 1) == 0)
+			PANIC ("vm_get_frame: every frame is pinned");
+		memset (frame->kva, 0, PGSIZE);
+	}
+	list_init (&frame->pages);
+	frame->refs = 0;
+	frame->pins = 1;
+	frame->evicting = false;
+	frame->cache = NULL;
+	frame->checksum = 0;
+	frame->ksm = frame->ksm_hashed = false;
+
+	lock_acquire (&frame_lock);
+	// clock hand 바로 뒤에 넣음
+	frame_list_insert (frame);
+	if (!kswapd_awake && palloc_free_count (PAL_USER) < kswapd_low) {
+		kswapd_awake = true;
+		sema_up (&kswapd_sema);
+	}
+	lock_release (&frame_lock);
+	return frame;
+}
+
+/* Page-out daemon.  Woken by vm_get_frame() once fewer than
+ * KSWAPD_LOW user pages are free, it evicts frames, a swap
+ * cluster at a time, until KSWAPD_HIGH pages are free again and
+ * goes back to sleep.  Faults
+ * then rarely have to wait for an eviction of their own. */
+static void
+kswapd (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&kswapd_sema);
+		while (palloc_free_count (PAL_USER) < kswapd_high) {
+			struct frame *frames[SWAP_CLUSTER];
+			size_t n = vm_evict_frames (frames, SWAP_CLUSTER);
+			size_t i;
+
+			if (n == 0)
+				break;
+			for (i = 0; i < n; i++) {
+				palloc_free_page (frames[i]->kva);
+				free (frames[i]);
+			}
+		}
+		lock_acquire (&frame_lock);
+		kswapd_awake = false;
+		lock_release (&frame_lock);
+	}
+}
+
+/* Same-page merging daemon.  Anonymous frames with the same
+ * contents, common among processes forked from one parent that
+ * computed the same data, are merged into one frame shared
+ * read-only, which vm_handle_wp() copies again on a write.  Frames
+ * of nothing but zeros are merged into the zero frame.
+ *
+ * ksmd walks the frame table a batch at a time with frame_lock
+ * held, entering each frame in ksm_table by checksum.  A frame that
+ * finds a match there is compared byte for byte and merged.  Only
+ * frames whose checksum did not change since the previous pass are
+ * considered, so that pages still being written are left alone. */
+static void
+ksmd (void *aux UNUSED) {
+	for (;;) {
+		size_t i;
+
+		timer_sleep (KSM_INTERVAL);
+		lock_acquire (&frame_lock);
+		for (i = 0; i < KSM_BATCH && !list_empty (&frame_list); i++) {
+			struct frame *frame;
+
+			if (ksm_hand == NULL || ksm_hand == list_end (&frame_list)) {
+				/* Start a new pass. */
+				hash_clear (&ksm_table, ksm_unhash);
+				ksm_hand = list_begin (&frame_list);
+			}
+			frame = list_entry (ksm_hand, struct frame, elem);
+			ksm_hand = list_next (ksm_hand);
+			ksm_scan_frame (frame);
+		}
+		lock_release (&frame_lock);
+	}
+}
+
+/* Looks at FRAME for ksmd, merging it if another frame holds the
+ * same bytes.  Must be called with frame_lock held. */
+static void
+ksm_scan_frame (struct frame *frame) {
+	uint64_t checksum;
+	struct hash_elem *e;
+
+	if (frame->ksm_hashed || !ksm_mergeable (frame))
+		return;
+	checksum = hash_bytes (frame->kva, PGSIZE);
+	if (checksum != frame->checksum) {
+		/* Still changing; look again next pass. */
+		frame->checksum = checksum;
+		return;
 	}
-	// frame list에 맨 끝에 넣음
-	list_push_back(&frame_list,&frame->elem);
+	if (checksum == zero_checksum && ksm_merge (frame, &zero_frame)) {
+		ksm_zero_merged++;
+		return;
+	}
+	e = hash_insert (&ksm_table, &frame->ksm_elem);
+	if (e == NULL)
+		frame->ksm_hashed = true;
+	else
+		ksm_merge (frame, hash_entry (e, struct frame, ksm_elem));
+}
 
-	frame->page = NULL;
-	ASSERT (frame != NULL);
-	ASSERT (frame->page == NULL);
+/* Returns true if FRAME may be merged: it holds anonymous pages
+ * only and is neither pinned nor being evicted. */
+static bool
+ksm_mergeable (struct frame *frame) {
+	struct list_elem *e;
+
+	if (frame->pins > 0 || frame->evicting || frame->refs == 0)
+		return false;
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		/* Merging would split a huge page for one frame. */
+		if (VM_TYPE (p->operations->type) != VM_ANON
+				|| pml4_is_huge (p->pml4, p->va))
+			return false;
+	}
+	return true;
+}
+
+/* Merges FRAME into INTO if both hold the same bytes, remapping
+ * every page of FRAME read-only to INTO and freeing FRAME.  Returns
+ * true if successful.  Must be called with frame_lock held. */
+static bool
+ksm_merge (struct frame *frame, struct frame *into) {
+	if (into != &zero_frame) {
+		if (!ksm_mergeable (into))
+			return false;
+		frame_write_protect (into);
+	}
+	/* Once both are read-only, a write to either has to fault and
+	 * wait for frame_lock, so they cannot change under memcmp().
+	 * The zero frame is never writable. */
+	frame_write_protect (frame);
+	if (memcmp (frame->kva, into->kva, PGSIZE))
+		return false;
+
+	while (!list_empty (&frame->pages)) {
+		struct page *p = list_entry (list_front (&frame->pages),
+				struct page, frame_elem);
+
+		/* Frees FRAME along with its last page. */
+		frame_remove_page (p);
+		frame_add_page (into, p);
+		pml4_set_page (p->pml4, p->va, into->kva, false);
+	}
+	into->ksm = into != &zero_frame;
+	ksm_merged++;
+	return true;
+}
+
+/* Maps every page sharing FRAME read-only. */
+static void
+frame_write_protect (struct frame *frame) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		pml4_set_writable (p->pml4, p->va, false);
+	}
+}
+
+/* Returns a hash of the checksum of frame E, for ksm_table. */
+static uint64_t
+ksm_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_entry (e, struct frame, ksm_elem)->checksum;
+}
+
+/* Orders frames A and B by checksum, for ksm_table.  Frames with
+ * equal checksums compare equal, so inserting a frame finds any
+ * frame that probably has the same contents. */
+static bool
+ksm_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct frame, ksm_elem)->checksum
+		< hash_entry (b, struct frame, ksm_elem)->checksum;
+}
+
+/* Marks frame E as out of ksm_table, which is being cleared. */
+static void
+ksm_unhash (struct hash_elem *e, void *aux UNUSED) {
+	hash_entry (e, struct frame, ksm_elem)->ksm_hashed = false;
+}
+
+/* Prints frame-sharing statistics. */
+void
+vm_print_stats (void) {
+	struct vm_stat st;
+	int i;
+
+	vm_read_stats (&st, true);
+	printf ("ksm: %lld frames merged, %lld of them into the zero frame, "
+			"%lld copied again on write\n",
+			ksm_merged, ksm_zero_merged, ksm_split);
+	printf ("vm: %lld minor and %lld major faults, %lld growing the stack, "
+			"%lld copy-on-write\n",
+			st.minor_faults, st.major_faults, st.stack_faults, st.cow_faults);
+	printf ("vm: evicted %lld anonymous, %lld file and %lld page cache "
+			"frames; %lld swapped in, %lld out, %lld written back\n",
+			st.anon_evictions, st.file_evictions, st.cache_evictions,
+			st.swap_ins, st.swap_outs, st.writebacks);
+	printf ("vm: fault latency:");
+	for (i = 0; i < VMSTAT_LAT_BUCKETS; i++)
+		if (st.fault_latency[i] > 0) {
+			if (i < VMSTAT_LAT_BUCKETS - 1)
+				printf (" <2^%d:", VMSTAT_LAT_SHIFT + i);
+			else
+				printf (" more:");
+			printf (" %lld", st.fault_latency[i]);
+		}
+	printf (" cycles\n");
+}
+
+/* Copies the VM event counters of the whole system, if SYSTEM, or
+ * of the current process into ST. */
+void
+vm_read_stats (struct vm_stat *st, bool system) {
+	enum intr_level old_level = intr_disable ();
+
+	*st = system ? vm_stats : thread_current ()->vm_stat;
+	intr_set_level (old_level);
+}
+
+/* Counts a fault served by the current process in CYCLES. */
+static void
+vm_count_fault (uint64_t cycles) {
+	struct thread *t = thread_current ();
+	int i = 0;
+
+	while (i < VMSTAT_LAT_BUCKETS - 1
+			&& cycles >= (uint64_t) 1 << (VMSTAT_LAT_SHIFT + i))
+		i++;
+	if (t->fault_major)
+		VM_COUNT (t, major_faults, 1);
+	else
+		VM_COUNT (t, minor_faults, 1);
+	VM_COUNT (t, fault_latency[i], 1);
+}
+
+/* Makes PAGE one more of the pages sharing FRAME.  Must be called
+ * with frame_lock held. */
+static void
+frame_add_page (struct frame *frame, struct page *page) {
+	list_push_back (&frame->pages, &page->frame_elem);
+	frame->refs++;
+	page->frame = frame;
+	if (frame != &zero_frame && page->owner != NULL)
+		page->owner->rss++;
+}
+
+/* Detaches every page sharing FRAME, which an evictor has already
+ * unmapped and written out.  Must be called with frame_lock
+ * held. */
+static void
+frame_detach (struct frame *frame) {
+	while (!list_empty (&frame->pages)) {
+		struct page *p = list_entry (list_pop_front (&frame->pages),
+				struct page, frame_elem);
+		p->frame = NULL;
+		if (p->owner != NULL)
+			p->owner->rss--;
+	}
+	frame->refs = 0;
+}
+
+/* Acquires frame_lock once PAGE's frame, if it has one, is not
+ * being evicted. */
+static void
+frame_lock_page (struct page *page) {
+	lock_acquire (&frame_lock);
+	while (page->frame != NULL && page->frame->evicting)
+		cond_wait (&frame_evicted, &frame_lock);
+}
+
+/* Pins the frame holding PAGE, waiting out an eviction of it, and
+ * returns it, or a null pointer if PAGE is not resident. */
+struct frame *
+vm_frame_pin (struct page *page) {
+	struct frame *frame;
+
+	frame_lock_page (page);
+	frame = page->frame;
+	if (frame != NULL)
+		frame->pins++;
+	lock_release (&frame_lock);
+	return frame;
+}
+
+/* Undoes vm_frame_pin(). */
+void
+vm_frame_unpin (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	ASSERT (frame->pins > 0);
+	/* page_cache_release() waits for cache frames to be unpinned. */
+	if (--frame->pins == 0 && frame->cache != NULL)
+		cond_broadcast (&frame_evicted, &frame_lock);
+	lock_release (&frame_lock);
+}
+
+/* Lends the frame holding the current process's page VA to a
+ * kernel buffer, as a pipe does to hand a page to its reader
+ * without copying it.  The page is write-protected, so that the
+ * process's next write to it gets a copy of its own, and the frame
+ * gains a reference and a pin of the borrower's, for vm_frame_take()
+ * or vm_frame_put() to drop.  Only a resident private anonymous page
+ * can be lent.  Returns the frame, or a null pointer if the page
+ * cannot be. */
+struct frame *
+vm_frame_lend (void *va) {
+	struct page *page = spt_find_page (&thread_current ()->spt, va);
+	struct frame *frame;
+
+	if (page == NULL || VM_TYPE (page->operations->type) != VM_ANON)
+		return NULL;
+	frame_lock_page (page);
+	frame = page->frame;
+	if (frame == NULL || frame == &zero_frame || frame->cache != NULL) {
+		lock_release (&frame_lock);
+		return NULL;
+	}
+	frame_write_protect (frame);
+	frame->refs++;
+	frame->pins++;
+	lock_release (&frame_lock);
 	return frame;
 }
 
-/* Growing the stack. */
+/* Maps FRAME, lent by vm_frame_lend(), copy-on-write at the current
+ * process's page VA in place of what it held, and drops the lent
+ * reference.  VA must be a writable private anonymous page that the
+ * caller, and nobody else, has pinned for writing with
+ * vm_pin_user_page(); the caller's pin moves over to FRAME in place
+ * of the lent one, so vm_unpin_user_page() still undoes it.
+ * Returns false, leaving FRAME lent, if VA is not such a page. */
+bool
+vm_frame_take (void *va, struct frame *frame) {
+	struct page *page = spt_find_page (&thread_current ()->spt, va);
+	struct frame *old;
+
+	if (page == NULL || VM_TYPE (page->operations->type) != VM_ANON
+			|| !page->writable)
+		return false;
+	frame_lock_page (page);
+	old = page->frame;
+	if (old == NULL || old->pins != 1 || old->refs != 1) {
+		lock_release (&frame_lock);
+		return false;
+	}
+	old->pins--;
+	frame_remove_page (page);
+	frame_add_page (frame, page);
+	/* The page was mapped, so its page tables exist already. */
+	if (!pml4_set_page (page->pml4, page->va, frame->kva, false))
+		PANIC ("vm_frame_take: cannot map %p", page->va);
+	/* The page holds the borrower's reference now. */
+	frame->refs--;
+	lock_release (&frame_lock);
+	return true;
+}
+
+/* Drops the reference and pin of FRAME lent by vm_frame_lend(),
+ * freeing it if no page maps it anymore. */
+void
+vm_frame_put (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	ASSERT (frame->refs > 0 && frame->pins > 0);
+	frame->pins--;
+	if (--frame->refs == 0)
+		vm_frame_free (frame);
+	lock_release (&frame_lock);
+}
+
+/* Returns true if FRAME has to be written out before it is
+ * evicted.  Must be called with frame_lock held. */
+bool
+vm_frame_is_dirty (struct frame *frame) {
+	return !frame_is_clean (frame);
+}
+
+/* Frees FRAME, which holds no page and is out of reach of the
+ * evictor.  Must be called with frame_lock held. */
+void
+vm_frame_free (struct frame *frame) {
+	ASSERT (frame->refs == 0 && frame->cache == NULL && frame->pins == 0);
+	frame_list_remove (frame);
+	palloc_free_page (frame->kva);
+	free (frame);
+}
+
+/* Waits, with frame_lock held, for an eviction to finish or a
+ * frame to change state as vm_frame_wake() announces. */
+void
+vm_frame_wait (void) {
+	cond_wait (&frame_evicted, &frame_lock);
+}
+
+/* Wakes up the threads in vm_frame_wait().  Must be called with
+ * frame_lock held. */
+void
+vm_frame_wake (void) {
+	cond_broadcast (&frame_evicted, &frame_lock);
+}
+
+/* Returns true if CNT more frames can be had without dipping into
+ * the pages kswapd keeps free, so that speculative work such as
+ * reading ahead does not push anything out. */
+bool
+vm_frames_plentiful (size_t cnt) {
+	return palloc_free_count (PAL_USER) >= kswapd_low + cnt;
+}
+
+/* Returns true if a page sharing FRAME has been written to since
+ * the dirty bits were last cleared, or the page cache page it holds
+ * has been, and clears them, so that a write from then on is
+ * noticed again.  A caller about to write the frame out must have
+ * it pinned and call this first. */
+bool
+vm_frame_test_and_clean (struct frame *frame) {
+	struct list_elem *e;
+	bool dirty = false;
+
+	lock_acquire (&frame_lock);
+	if (frame->cache != NULL && frame->cache->page_cache.dirty) {
+		dirty = true;
+		frame->cache->page_cache.dirty = false;
+	}
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+
+		if (pml4_is_dirty (p->pml4, p->va)) {
+			dirty = true;
+			pml4_set_dirty (p->pml4, p->va, false);
+		}
+	}
+	lock_release (&frame_lock);
+	return dirty;
+}
+
+/* Unmaps PAGE and detaches it from its frame, if it has one.  The
+ * frame is freed once no page shares it, unless the page cache
+ * holds on to it, in which case the cache inherits PAGE's dirty
+ * bit.  Must be called with frame_lock held and PAGE's frame not
+ * being evicted. */
+static void
+frame_remove_page (struct page *page) {
+	struct frame *frame = page->frame;
+
+	if (frame->cache != NULL && pml4_is_dirty (page->pml4, page->va))
+		frame->cache->page_cache.dirty = true;
+	list_remove (&page->frame_elem);
+	pml4_clear_page (page->pml4, page->va);
+	page->frame = NULL;
+	if (frame != &zero_frame && page->owner != NULL)
+		page->owner->rss--;
+	if (--frame->refs == 0 && frame != &zero_frame && frame->cache == NULL) {
+		ASSERT (frame->pins == 0);
+		frame_list_remove (frame);
+		palloc_free_page (frame->kva);
+		free (frame);
+	}
+}
+
+/* Makes the frame holding PAGE, if PAGE is resident and the only
+ * page mapping it, the next one the clock hand looks at, with its
+ * accessed bits clear, so that it is evicted before any other. */
+void
+vm_frame_deactivate (struct page *page) {
+	struct frame *frame;
+
+	lock_acquire (&frame_lock);
+	frame = page->frame;
+	if (frame != NULL && frame != &zero_frame && frame->refs == 1
+			&& !frame->evicting && frame->pins == 0) {
+		pml4_set_accessed (page->pml4, page->va, false);
+		if (frame->cache != NULL)
+			frame->cache->page_cache.accessed = false;
+		if (clock_hand != &frame->elem) {
+			if (ksm_hand == &frame->elem)
+				ksm_hand = list_next (ksm_hand);
+			list_remove (&frame->elem);
+			if (clock_hand == NULL || clock_hand == list_end (&frame_list))
+				list_push_front (&frame_list, &frame->elem);
+			else
+				list_insert (clock_hand, &frame->elem);
+			clock_hand = &frame->elem;
+		}
+	}
+	lock_release (&frame_lock);
+}
+
+/* Unmaps PAGE and detaches it from its frame, if it has one, after
+ * waiting for any eviction of the frame to finish. */
+void
+vm_drop_frame (struct page *page) {
+	frame_lock_page (page);
+	if (page->frame != NULL)
+		frame_remove_page (page);
+	lock_release (&frame_lock);
+}
+
+/* Growing the stack.  The stack area, the one just below
+ * USER_STACK, is extended down to ADDR's page, whose pages are
+ * created as they are faulted on. */
 static void
 vm_stack_growth (void *addr UNUSED) {
-	thread_current()->stack_bottom = addr;
-	vm_alloc_page(VM_ANON | IS_STACK |IS_WRITABLE, addr,true);
+	struct thread *t = thread_current ();
+	struct vma *stack = vma_find (&t->vmas, (uint8_t *) USER_STACK - 1);
 
-	vm_claim_page(addr);
+	addr = pg_round_down (addr);
+	if (stack != NULL && vma_grow_down (&t->vmas, stack, addr)) {
+		t->stack_bottom = addr;
+		VM_COUNT (t, stack_faults, 1);
+	}
 }
 
-/* Handle the fault on write_protected page */
+/* Handle the fault on write_protected page.  PAGE is writable but
+ * mapped read-only because it shares its frame copy-on-write: give
+ * it a copy of its own, or just its write access back if the other
+ * sharers are gone. */
 static bool
 vm_handle_wp (struct page *page UNUSED) {
+	struct frame *frame;
+	struct frame *copy;
+	bool success;
+
+	frame_lock_page (page);
+	frame = page->frame;
+	/* Shared mappings write to the cache frame itself. */
+	if (frame == NULL || (frame->refs == 1 && frame != &zero_frame)
+			|| frame->cache != NULL) {
+		/* If an evictor took the frame meanwhile, the access will
+		 * fault again as not present. */
+		if (frame != NULL)
+			pml4_set_writable (page->pml4, page->va, true);
+		lock_release (&frame_lock);
+		return true;
+	}
+	/* Keep the original from being evicted while we copy it. */
+	if (frame->ksm)
+		ksm_split++;
+	VM_COUNT (thread_current (), cow_faults, 1);
+	frame->pins++;
+	lock_release (&frame_lock);
+
+	/* Only a copy of the zero frame adds to the resident set. */
+	if (frame == &zero_frame)
+		vm_rss_trim (page->owner);
+	/* A fresh frame is already zeroed. */
+	copy = vm_get_frame ();
+	if (frame != &zero_frame)
+		memcpy (copy->kva, frame->kva, PGSIZE);
+
+	lock_acquire (&frame_lock);
+	frame->pins--;
+	frame_remove_page (page);
+	frame_add_page (copy, page);
+	success = pml4_set_page (page->pml4, page->va, copy->kva, true);
+	copy->pins--;
+	lock_release (&frame_lock);
+	return success;
 }
 
 /* Return true on success */
 bool
 vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
+	uint64_t start = rdtsc ();
+
+	// 처리 중에 disk를 읽으면 major fault
+	thread_current ()->fault_major = false;
+	if (!vm_handle_fault (f, addr, user, write, not_present))
+		return false;
+	vm_count_fault (rdtsc () - start);
+	return true;
+}
+
+/* Does the work of vm_try_handle_fault(). */
+static bool
+vm_handle_fault (struct intr_frame *f, void *addr, bool user,
+		bool write, bool not_present) {
 	
 	struct hash *spt UNUSED = &thread_current ()->spt;
 	struct page *page = spt_find_page(spt,addr);
@@ -225,23 +1038,45 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 	if(page == NULL)
 	{
 		void *rsp = f->rsp;
+		struct rb_tree *vmas = &thread_current ()->vmas;
+		struct vma *vma = vma_find (vmas, addr);
 
-		if((uint64_t)addr > STACK_LIMIT && USER_STACK > (uint64_t)addr && rsp - 8 <= addr)
+		if(vma == NULL && (uint64_t)addr > STACK_LIMIT && USER_STACK > (uint64_t)addr && rsp - 8 <= addr)
 		{
-			vm_stack_growth(thread_current()->stack_bottom - PGSIZE);
-			return true;
+			vm_stack_growth(addr);
+			vma = vma_find (vmas, addr);
 		}
-		// printf("stack_growth fail\n");
-		return false;
+		// 처음 접근하는 주소: 속한 영역에서 page를 만듦
+		if (vma == NULL || (write && !vma->writable))
+			return false;
+		page = vma_get_page (vma, addr);
+		if (page == NULL || !vm_claim_on_fault (page, write))
+			return false;
+		vma_fault_around (vma, addr);
+		vm_promote (page);
+		return true;
 	}
 	if(is_kernel_vaddr(addr)&&user)
 	{	
 		printf("this is kernel_vaddr\n");
 		return false;
 	}
+	// 이미 매핑된 페이지에 쓰기: copy-on-write
+	if(!not_present) {
+		if (!write || !page->writable || !vm_handle_wp (page))
+			return false;
+		vm_promote (page);
+		return true;
+	}
+	// evict 중이던 page라면 끝날 때까지 기다림
+	frame_lock_page (page);
+	bool resident = page->frame != NULL;
+	lock_release (&frame_lock);
+	if (resident)
+		return true;
 	// printf("page->operations->type:%d\n",page->operations->type);
 	// printf("IS_WRITABLE(page->anon.type):%d\n",IS_WRITABLE(page->anon.type));
-	switch (page->operations->type)
+	switch (VM_TYPE (page->operations->type))
 	{
 		case VM_UNINIT:
 			if(IS_STACK(page->uninit.type)|| (!IS_WRITABLE(page->uninit.type)&& write))
@@ -267,7 +1102,290 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 	/* TODO: Validate the fault */
 	/* TODO: Your code goes here */
 	// printf("[END] vm_try_handle_fault\n");
-	return vm_do_claim_page (page);
+	if (!vm_claim_on_fault (page, write))
+		return false;
+	vm_promote (page);
+	return true;
+}
+
+/* Claims PAGE for a fault that accessed it, writing if WRITE.  An
+ * anonymous page that was never loaded is all zeros, so reading it
+ * just maps the shared zero frame read-only; it gets a frame of its
+ * own from vm_handle_wp() on the first write. */
+static bool
+vm_claim_on_fault (struct page *page, bool write) {
+	bool success;
+
+	if (write || page->operations->type != VM_UNINIT
+			|| VM_TYPE (page->uninit.type) != VM_ANON
+			|| page->uninit.init != NULL)
+		return vm_do_claim_page (page);
+
+	/* Makes PAGE anonymous without touching the zero frame. */
+	if (!swap_in (page, zero_frame.kva))
+		return false;
+	lock_acquire (&frame_lock);
+	frame_add_page (&zero_frame, page);
+	success = pml4_set_page (page->pml4, page->va, zero_frame.kva, false);
+	lock_release (&frame_lock);
+	return success;
+}
+
+/* Pins the frame holding the current process's page VA, for a
+ * system call to read from it, or write to it if WRITE, without
+ * faulting.  The page is brought in, or given a frame of its own
+ * for writing, first, just as a fault on it would.  Returns the
+ * frame, to be unpinned with vm_frame_unpin(), or a null pointer if
+ * such an access would be a bad fault. */
+struct frame *
+vm_pin_user_page (void *va, bool write) {
+	struct thread *t = thread_current ();
+
+	va = pg_round_down (va);
+	if (va == NULL || !is_user_vaddr (va))
+		return NULL;
+	for (;;) {
+		struct page *page = spt_find_page (&t->spt, va);
+		struct frame *frame;
+
+		if (page == NULL) {
+			struct vma *vma = vma_find (&t->vmas, va);
+
+			if (vma == NULL || (write && !vma->writable))
+				return NULL;
+			page = vma_get_page (vma, va);
+			if (page == NULL)
+				return NULL;
+		}
+		if (write && !page->writable)
+			return NULL;
+
+		frame_lock_page (page);
+		frame = page->frame;
+		if (frame != NULL && (!write || frame->cache != NULL
+				|| (frame->refs == 1 && frame != &zero_frame))) {
+			frame->pins++;
+			lock_release (&frame_lock);
+			return frame;
+		}
+		lock_release (&frame_lock);
+
+		// 없는 page는 들여오고, 공유 중인 page는 복사본을 받은 뒤 다시 확인
+		if (frame == NULL ? !vm_claim_on_fault (page, write)
+				: !vm_handle_wp (page))
+			return NULL;
+	}
+}
+
+/* Undoes vm_pin_user_page() for the current process's page VA,
+ * whichever frame holds the page by now. */
+void
+vm_unpin_user_page (void *va) {
+	struct page *page = spt_find_page (&thread_current ()->spt,
+			pg_round_down (va));
+
+	/* A pinned page stays resident, so only this thread moves it. */
+	ASSERT (page != NULL && page->frame != NULL);
+	vm_frame_unpin (page->frame);
+}
+
+/* Transparent huge pages.  Once a fault has brought in the first or
+ * last page of a huge-page-aligned range of an anonymous area, and
+ * every page of the range is writable in a frame of its own, the
+ * range is copied into HPGCNT contiguous frames and mapped as one
+ * huge page, which takes one TLB entry instead of HPGCNT.  Each page
+ * keeps its own frame in the frame table; mmu.c splits the mapping
+ * back into small pages as soon as one of them is remapped, cleared
+ * or write-protected, so eviction, fork and exit work unchanged.
+ *
+ * A promotion copies HPGSIZE bytes and remaps HPGCNT pages inside
+ * the fault that set it off, so promotions are rationed system-wide:
+ * PROMOTE_BURST may happen back to back, and then one more every
+ * PROMOTE_TICKS timer ticks.  A range that misses out is promoted
+ * by a later fault on its first or last page. */
+#define PROMOTE_BURST 4
+#define PROMOTE_TICKS (TIMER_FREQ / 10)
+
+static int promote_credits = PROMOTE_BURST; /* Promotions allowed now. */
+static int64_t promote_earned;              /* Tick credits counted to. */
+
+/* Takes one promotion's worth of credit, earning what the ticks
+ * since the last call are worth first.  Returns false if none is
+ * left.  Must be called with frame_lock held. */
+static bool
+vm_promote_ration (void) {
+	int64_t now = timer_ticks ();
+	int64_t earned = (now - promote_earned) / PROMOTE_TICKS;
+
+	if (earned > 0) {
+		promote_credits = earned >= PROMOTE_BURST - promote_credits
+			? PROMOTE_BURST : promote_credits + earned;
+		promote_earned += earned * PROMOTE_TICKS;
+	}
+	if (promote_credits == 0)
+		return false;
+	promote_credits--;
+	return true;
+}
+
+static void
+vm_promote (struct page *page) {
+	struct vma *vma = page->vma;
+	uint8_t *base = hpg_round_down (page->va);
+	struct page **pages;
+	uint8_t *block = NULL;
+	size_t cnt, i;
+	bool ready;
+
+	if (vma == NULL || VM_TYPE (vma->type) != VM_ANON || !vma->writable
+			|| base < (uint8_t *) vma->start
+			|| base + HPGSIZE > (uint8_t *) vma->end)
+		return;
+	// 구간의 양 끝 page에서만 시도 (위로도 아래로도 채워지므로)
+	if (page->va != base && page->va != base + HPGSIZE - PGSIZE)
+		return;
+	if (pml4_is_huge (page->pml4, base) || !vm_frames_plentiful (HPGCNT))
+		return;
+	pages = malloc (HPGCNT * sizeof *pages);
+	if (pages == NULL)
+		return;
+
+	/* Pins the frames so that nothing moves them while we copy. */
+	lock_acquire (&frame_lock);
+	for (cnt = 0; cnt < HPGCNT; cnt++) {
+		struct page *p = spt_find_page (&thread_current ()->spt,
+				base + cnt * PGSIZE);
+		struct frame *frame = p != NULL ? p->frame : NULL;
+
+		if (frame == NULL || p->operations->type != VM_ANON || !p->writable
+				|| frame == &zero_frame || frame->refs != 1 || frame->pins > 0
+				|| frame->evicting || frame->ksm || frame->cache != NULL)
+			break;
+		frame->pins++;
+		pages[cnt] = p;
+	}
+	ready = cnt == HPGCNT && vm_promote_ration ();
+	lock_release (&frame_lock);
+
+	if (ready)
+		block = palloc_get_huge_page (PAL_USER);
+	if (block != NULL)
+		for (i = 0; i < HPGCNT; i++)
+			memcpy (block + i * PGSIZE, pages[i]->frame->kva, PGSIZE);
+
+	lock_acquire (&frame_lock);
+	if (block != NULL) {
+		for (i = 0; i < HPGCNT; i++) {
+			struct frame *frame = pages[i]->frame;
+			void *old = frame->kva;
+
+			frame->kva = block + i * PGSIZE;
+			pml4_set_page (page->pml4, pages[i]->va, frame->kva, true);
+			palloc_free_page (old);
+		}
+		/* Also flushes the small pages' stale TLB entries. */
+		if (!pml4_set_huge_page (page->pml4, base, block, true))
+			NOT_REACHED ();
+	}
+	for (i = 0; i < cnt; i++)
+		pages[i]->frame->pins--;
+	lock_release (&frame_lock);
+	free (pages);
+}
+
+/* Resident sets.  A page counts in the resident set of its owner,
+ * the process whose address space it is in, while it maps a frame
+ * other than the zero frame; the counts are protected by
+ * frame_lock.  A process may set a limit on its resident set, which
+ * fork() passes on.  Before a process over its limit takes another
+ * frame, it evicts frames of its own, so that a process running
+ * through more memory than it may have pushes out its own working
+ * set rather than everybody else's. */
+
+/* Returns the process that pages created now belong to.  A vfork()
+ * child's pages are its parent's. */
+static struct thread *
+rss_owner (void) {
+	struct thread *t = thread_current ();
+	return t->vfork_parent != NULL ? t->vfork_parent : t;
+}
+
+/* Returns true if CNT more pages fit in OWNER's resident set. */
+static bool
+rss_has_room (struct thread *owner, size_t cnt) {
+	return owner == NULL || owner->rss_limit == 0
+		|| owner->rss + cnt <= owner->rss_limit;
+}
+
+/* If OWNER, the owner of the current address space, has no room for
+ * one more page, evicts frames that only its pages map until it has.
+ * A little more than needed goes at once, since finding victims
+ * means a walk over the whole address space.  The walk is a clock
+ * of two rounds: the first spares frames accessed since the
+ * previous walk, clearing their accessed bits, and the second
+ * takes any frame. */
+static void
+vm_rss_trim (struct thread *owner) {
+	struct frame *frames[SWAP_CLUSTER];
+	struct hash_iterator i;
+	size_t want, n = 0, j;
+	int round;
+
+	if (owner != rss_owner ())
+		return;
+	lock_acquire (&frame_lock);
+	if (rss_has_room (owner, 1)) {
+		lock_release (&frame_lock);
+		return;
+	}
+	want = owner->rss + 1 - owner->rss_limit + owner->rss_limit / 32;
+	if (want > SWAP_CLUSTER)
+		want = SWAP_CLUSTER;
+	for (round = 0; round < 2 && n < want; round++) {
+		hash_first (&i, &thread_current ()->spt);
+		while (n < want && hash_next (&i)) {
+			struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
+			struct frame *frame = p->frame;
+
+			if (frame == NULL || frame == &zero_frame || frame->refs != 1
+					|| frame->pins > 0 || frame->evicting || frame->cache != NULL)
+				continue;
+			if (round == 0 && frame_is_accessed (frame, true))
+				continue;
+			frame_isolate (frame);
+			frames[n++] = frame;
+		}
+	}
+	owner->rss_evicted += n;
+	lock_release (&frame_lock);
+
+	vm_write_out (frames, n);
+	for (j = 0; j < n; j++) {
+		palloc_free_page (frames[j]->kva);
+		free (frames[j]);
+	}
+}
+
+/* Limits the current process's resident set to PAGES pages, or
+ * lifts the limit if PAGES is 0.  A process already over the new
+ * limit goes under it as it takes more frames. */
+void
+vm_rss_limit (size_t pages) {
+	lock_acquire (&frame_lock);
+	rss_owner ()->rss_limit = pages;
+	lock_release (&frame_lock);
+}
+
+/* Fills in ST with the current process's resident set counters. */
+void
+vm_rss_stat (struct rss_stat *st) {
+	struct thread *owner = rss_owner ();
+
+	lock_acquire (&frame_lock);
+	st->rss = owner->rss;
+	st->limit = owner->rss_limit;
+	st->evicted = owner->rss_evicted;
+	lock_release (&frame_lock);
 }
 
 /* Free the page.
@@ -282,9 +1400,14 @@ vm_dealloc_page (struct page *page) {
 bool
 vm_claim_page (void *va UNUSED) {
 	// printf("%p\n",va);
-	struct page *page = spt_find_page(&thread_current()->spt,va);
+	struct thread *t = thread_current ();
+	struct page *page = spt_find_page(&t->spt,va);
 	if(page == NULL)
-		return false;
+	{
+		struct vma *vma = vma_find (&t->vmas, va);
+		if (vma == NULL || (page = vma_get_page (vma, va)) == NULL)
+			return false;
+	}
 	// printf("page va :%p\n",page->va);
 	return vm_do_claim_page (page);
 }
@@ -293,22 +1416,89 @@ vm_claim_page (void *va UNUSED) {
 static bool
 vm_do_claim_page (struct page *page) {
 	// printf("[START]vm_do_claim_page\n");
-	struct frame *frame = vm_get_frame ();
-	struct thread *t = thread_current();
+	struct frame *frame;
+	bool success;
+
+	vm_rss_trim (page->owner);
+	frame = vm_shared_frame (page);
+	if (frame == NULL)
+		frame = vm_get_frame ();
 	// printf("%p\n",page->va);
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	lock_acquire (&frame_lock);
+	frame_add_page (frame, page);
+	lock_release (&frame_lock);
 	/* TODO: Insert page table entry to map page's VA to frame's PA. */
-	// printf("[DBG] do_claim_page(): pml4 set writable? %d\n", IS_WRITABLE(page->uninit.type)); ////
-	if(!pml4_set_page(t->pml4,page->va,frame->kva,IS_WRITABLE(page->uninit.type)))
+	if(!pml4_set_page(page->pml4,page->va,frame->kva,page->writable))
 	{
 		printf("[FAIL]vm_do_claim_page pml4_set_page fail\n");
 	}
-	// printf("pml4_get_page:%p\n",pml4_get_page(t->pml4,page->va));
-	// printf("kva : %p\n",page->frame->kva);
 	// printf("[END] vm_do_claim_page\n");
-	return swap_in (page, frame->kva);
+	/* The frame stays pinned while swap_in sleeps on I/O. */
+	success = swap_in (page, frame->kva);
+	vm_frame_unpin (frame);
+	return success;
+}
+
+/* Returns the page cache frame holding PAGE's data, pinned, if
+ * PAGE is in a shared file mapping and within the file, so that
+ * PAGE maps the cache frame itself.  Returns a null pointer if
+ * PAGE gets a private frame. */
+static struct frame *
+vm_shared_frame (struct page *page) {
+	struct vma *vma = page->vma;
+	size_t ofs;
+
+	if (vma == NULL || !IS_SHARED (vma->type))
+		return NULL;
+	ofs = (uint8_t *) page->va - (uint8_t *) vma->start;
+	if (ofs >= vma->file_bytes)
+		return NULL;
+	return page_cache_get (file_get_inode (vma->file), vma->offset + ofs);
+}
+
+/* Claims the CNT pages in PAGES, all uninitialized and at most
+ * VM_CLAIM_MAX, together.  FILL is called once with all of their
+ * frames to fill them before the pages are initialized and mapped,
+ * so that the caller can read them in one go.  The pages are only
+ * wanted speculatively, so nothing is evicted for them: returns
+ * false, claiming none, if fewer pages are free than kswapd keeps
+ * around plus CNT, if they would take the process over its
+ * resident set limit, or if FILL fails.  A page that could not be
+ * claimed is left uninitialized. */
+bool
+vm_claim_pages (struct page *pages[], size_t cnt,
+		vm_fill_func *fill, void *aux) {
+	struct frame *frames[VM_CLAIM_MAX];
+	void *kvas[VM_CLAIM_MAX];
+	bool success;
+	size_t i;
+
+	ASSERT (cnt <= VM_CLAIM_MAX);
+
+	if (!vm_frames_plentiful (cnt) || !rss_has_room (pages[0]->owner, cnt))
+		return false;
+	for (i = 0; i < cnt; i++) {
+		frames[i] = vm_get_frame ();
+		kvas[i] = frames[i]->kva;
+		lock_acquire (&frame_lock);
+		frame_add_page (frames[i], pages[i]);
+		lock_release (&frame_lock);
+	}
+
+	/* The frames stay pinned while FILL sleeps on I/O. */
+	success = fill (kvas, cnt, aux);
+	for (i = 0; i < cnt; i++) {
+		struct page *page = pages[i];
+		bool ok = success
+			&& pml4_set_page (page->pml4, page->va, kvas[i], page->writable)
+			&& swap_in (page, kvas[i]);
+
+		vm_frame_unpin (frames[i]);
+		if (!ok)
+			vm_drop_frame (page);
+	}
+	return success;
 }
 
 /* Initialize new supplemental page table */
@@ -322,48 +1512,71 @@ supplemental_page_table_init (struct hash *spt UNUSED) {
 	}
 	// printf("[END] supplemental_page_table_init \n");
 }
-bool lazy_fork_load(struct page *page, void *aux) {
-	struct page *src= (struct page*) aux;
-	memcpy(page->frame->kva,src->frame->kva,PGSIZE);
-	return true;
-}
-
-void hash_insert_new_func (struct hash_elem *e, void *aux){
-	// src -> dst 
-	struct hash* child_spt = (struct hash *)aux;
-	struct page* page = hash_entry(e,struct page, hash_elem);
-	switch (page->operations->type)
-	{
-	case VM_UNINIT:
-		vm_alloc_page_with_initializer(page->uninit.type,page->va,
-		IS_WRITABLE(page->uninit.type),page->uninit.init,page->uninit.aux);
-		break;
-	case VM_ANON:
-		vm_alloc_page_with_initializer(page->anon.type,page->va,
-		IS_WRITABLE(page->anon.type),lazy_fork_load, page);
-		vm_claim_page(page->va);
-		break;
-	case VM_FILE:
-		vm_alloc_page_with_initializer(page->file.type,page->va,
-		IS_WRITABLE(page->file.type),lazy_fork_load, page);
-		vm_claim_page(page->va);
-		break;
-	}
-
-}
-void print (struct hash_elem *e, void *aux){
-	struct page* page = hash_entry(e,struct page, hash_elem);
-	// printf("page->va :%p page->type :%d \n",page->va,page->operations->type);
-}
-/* Copy supplemental page table from src to dst */
+/* Copy supplemental page table from src to dst.  Resident pages
+ * are not copied: the child shares the parent's frames read-only
+ * and vm_handle_wp() copies a page on the first write to it, so
+ * fork only costs page table entries.  The child's areas must have
+ * been copied already; pages never faulted on are left for the
+ * child to create from them. */
 bool
 supplemental_page_table_copy (struct hash *dst UNUSED,
 		struct hash *src UNUSED) {
-	hash_apply(src,print);
-	src->aux = dst;
-	hash_apply(src,hash_insert_new_func);
+	struct hash_iterator i;
+
+	hash_first (&i, src);
+	while (hash_next (&i)) {
+		struct page *page = hash_entry (hash_cur (&i), struct page, hash_elem);
+		if (!spt_copy_page (dst, page))
+			return false;
+	}
+	return true;
+}
+
+/* Adds a copy of the parent's PAGE to the child's DST. */
+static bool
+spt_copy_page (struct hash *dst, struct page *page) {
+	struct page *child;
+
+	if (page->operations->type == VM_UNINIT)
+		return true;
+
+	child = malloc (sizeof *child);
+	if (child == NULL)
+		return false;
+
+	/* Copy PAGE only once an evictor is done with it. */
+	frame_lock_page (page);
+	*child = *page;
+	child->pml4 = thread_current ()->pml4;
+	child->owner = thread_current ();
+	child->frame = NULL;
+	if (page->frame != NULL) {
+		/* A shared mapping stays shared: both write the cache frame. */
+		bool shared = page->frame->cache != NULL;
+
+		if (!pml4_set_page (child->pml4, child->va, page->frame->kva,
+					shared && child->writable)) {
+			lock_release (&frame_lock);
+			free (child);
+			return false;
+		}
+		if (!shared)
+			pml4_set_writable (page->pml4, page->va, false);
+		frame_add_page (page->frame, child);
+	} else if (VM_TYPE (page->operations->type) == VM_ANON)
+		anon_fork (child);
+	lock_release (&frame_lock);
+
+	child->vma = vma_find (&thread_current ()->vmas, child->va);
+	ASSERT (child->vma != NULL);
+	list_push_back (&child->vma->pages, &child->vma_elem);
+	// 자식의 영역이 가진 file을 씀
+	if (VM_TYPE (page->operations->type) == VM_FILE)
+		child->file.file = child->vma->file;
+	spt_insert_page (dst, child);
 	return true;
 }
+
 void kill_func (struct hash_elem *e, void *aux){
 	struct page *page = hash_entry(e,struct page, hash_elem);
 	vm_dealloc_page(page);
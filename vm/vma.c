@@ -0,0 +1,748 @@
+/* vma.c: Virtual memory areas.
+ *
+ * A process's address space is a set of non-overlapping areas kept
+ * in a red-black tree sorted by address, so that finding the area
+ * of an address, or checking a new mapping for overlaps, takes
+ * O(log n) time in the number of areas.  ELF segments, the stack,
+ * and mmap() regions are each one area, however large.
+ *
+ * The supplemental page table only holds pages that have been
+ * faulted on.  vm_try_handle_fault() creates the struct page for
+ * an address from its area on the first fault, and each area keeps
+ * a list of the pages created in it so that removing the area only
+ * visits those.
+ *
+ * A fault on a page that comes from a file also maps the
+ * neighbouring pages of the same FAULT_AROUND_PAGES-page window
+ * that the page cache already holds and somebody has used lately,
+ * so that code and files other processes are using take one fault
+ * per window rather than per page.  Fault-around never reads the
+ * disk, and leaves pages the cache merely read ahead alone, so a
+ * mapping nobody has touched stays lazily loaded page by page.
+ *
+ * Pages of a shared file mapping are not read at all: they map the
+ * file's page cache frames themselves.
+ *
+ * Writing a file mapping back goes the other way: only pages whose
+ * dirty bit is set are written to the page cache, each run of
+ * consecutive dirty pages in one go, and from there to disk.
+ *
+ * madvise() tunes this per area.  MADV_RANDOM turns fault-around
+ * off.  MADV_SEQUENTIAL reads SEQ_AHEAD_PAGES ahead of the faulting
+ * page instead of around it, from disk if need be, and hands the pages as far behind it
+ * to the evictor to go first, so that a scan of a big file does not
+ * push everybody else's pages out.  MADV_WILLNEED has kworkerd read
+ * the file behind a range into the page cache, and MADV_DONTNEED
+ * destroys the pages of a range at once. */
+
+#include "vm/vma.h"
+#include <debug.h>
+#include <mman.h>
+#include <round.h>
+#include <stdlib.h>
+#include "filesys/file.h"
+#include "filesys/page_cache.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+static bool vma_less (const struct rb_node *, const struct rb_node *,
+		void *aux);
+static struct page *vma_new_page (struct vma *, void *va,
+		vm_initializer *init);
+static bool vma_init_page (struct page *page, void *aux);
+static bool vma_load_page (struct page *page, void *aux);
+static size_t vma_page_file_bytes (const struct vma *, size_t ofs);
+static void vma_prefetch (struct vma *, void *start, void *end,
+		bool recent);
+static bool vma_page_recent (struct vma *, void *va);
+static void vma_read_run (struct vma *, void *start, size_t cnt);
+static vm_fill_func vma_fill;
+static void vma_write_run (struct vma *, struct page *pages[],
+		struct frame *frames[], size_t cnt);
+static int vma_page_cmp (const void *, const void *);
+static void vma_sync_file (struct vma *, void *start, void *end);
+static void vma_drop_behind (struct vma *, void *va);
+static void vma_discard (struct vma *, void *start, void *end);
+
+/* A run of pages being read by vma_read_run(). */
+struct vma_run {
+	struct vma *vma;
+	off_t offset;               /* File offset of the first page. */
+	size_t bytes;               /* Bytes to read from there. */
+};
+
+/* Initializes TREE as an address space with no areas. */
+void
+vma_init (struct rb_tree *tree) {
+	rb_init (tree);
+}
+
+/* Adds an area of LENGTH bytes at START to TREE, with pages of
+ * TYPE, writable if WRITABLE.  If FILE is non-null, the first
+ * FILE_BYTES bytes of the area come from FILE starting at OFFSET,
+ * and the area takes over the caller's reference to FILE; the rest
+ * of the area is zero.  START and LENGTH must be page-aligned.
+ * Returns the new area, or a null pointer if it would overlap an
+ * existing one or memory is exhausted. */
+struct vma *
+vma_create (struct rb_tree *tree, void *start, size_t length,
+		enum vm_type type, bool writable,
+		struct file *file, off_t offset, size_t file_bytes) {
+	struct vma *vma;
+
+	ASSERT (pg_ofs (start) == 0 && pg_ofs ((void *) length) == 0);
+	ASSERT (length > 0);
+	ASSERT (file_bytes <= length);
+
+	if (vma_overlaps (tree, start, length))
+		return NULL;
+	vma = malloc (sizeof *vma);
+	if (vma == NULL)
+		return NULL;
+	vma->start = start;
+	vma->end = (uint8_t *) start + length;
+	vma->type = type;
+	vma->writable = writable;
+	vma->mmap = false;
+	vma->advice = MADV_NORMAL;
+	vma->file = file;
+	vma->offset = offset;
+	vma->file_bytes = file_bytes;
+	list_init (&vma->pages);
+	rb_insert (tree, &vma->node, vma_less, NULL);
+	return vma;
+}
+
+/* Returns the area of TREE that contains ADDR, or a null pointer if
+ * none does. */
+struct vma *
+vma_find (const struct rb_tree *tree, const void *addr) {
+	struct rb_node *node = tree->root;
+
+	while (node != NULL) {
+		struct vma *vma = rb_entry (node, struct vma, node);
+
+		if (addr < vma->start)
+			node = node->left;
+		else if (addr >= vma->end)
+			node = node->right;
+		else
+			return vma;
+	}
+	return NULL;
+}
+
+/* Returns true if any area of TREE overlaps the LENGTH bytes at
+ * START. */
+bool
+vma_overlaps (const struct rb_tree *tree, const void *start, size_t length) {
+	const void *end = (const uint8_t *) start + length;
+	struct rb_node *node = tree->root;
+
+	/* Since areas are disjoint and sorted, one that ends before
+	 * START has no overlapping area to its left, and one that
+	 * starts after END none to its right. */
+	while (node != NULL) {
+		struct vma *vma = rb_entry (node, struct vma, node);
+
+		if (end <= vma->start)
+			node = node->left;
+		else if (start >= vma->end)
+			node = node->right;
+		else
+			return true;
+	}
+	return false;
+}
+
+/* Extends VMA, an area of TREE with no file, down to START, which
+ * must be page-aligned.  Returns false if that would run into
+ * another area. */
+bool
+vma_grow_down (struct rb_tree *tree, struct vma *vma, void *start) {
+	ASSERT (pg_ofs (start) == 0);
+	ASSERT (vma->file == NULL);
+
+	if (start >= vma->start)
+		return true;
+	if (vma_overlaps (tree, start, (uint8_t *) vma->start - (uint8_t *) start))
+		return false;
+	/* Still sorted: nothing lies in between. */
+	vma->start = start;
+	return true;
+}
+
+/* Extends VMA, an area of TREE with no file, up to END, which must
+ * be page-aligned.  Returns false if that would run into another
+ * area or into kernel space. */
+bool
+vma_grow_up (struct rb_tree *tree, struct vma *vma, void *end) {
+	ASSERT (pg_ofs (end) == 0);
+	ASSERT (vma->file == NULL);
+
+	if (end <= vma->end)
+		return true;
+	if ((uint64_t) end > KERN_BASE
+			|| vma_overlaps (tree, vma->end, (uint8_t *) end - (uint8_t *) vma->end))
+		return false;
+	vma->end = end;
+	return true;
+}
+
+/* Shrinks VMA, an area with no file, to end at END, which must be
+ * page-aligned and above its start, destroying the pages past it. */
+void
+vma_shrink (struct vma *vma, void *end) {
+	struct hash *spt = &thread_current ()->spt;
+	struct list_elem *e;
+
+	ASSERT (pg_ofs (end) == 0);
+	ASSERT (vma->file == NULL);
+	ASSERT (end > vma->start && end <= vma->end);
+
+	for (e = list_begin (&vma->pages); e != list_end (&vma->pages); ) {
+		struct page *page = list_entry (e, struct page, vma_elem);
+
+		e = list_next (e);
+		if (page->va >= end) {
+			list_remove (&page->vma_elem);
+			spt_remove_page (spt, page);
+		}
+	}
+	vma->end = end;
+}
+
+/* Returns the highest page-aligned address at which LENGTH bytes,
+ * a multiple of PGSIZE, fit between FLOOR and CEILING without
+ * overlapping an area of TREE, or a null pointer if they do not.
+ * Areas are placed top-down so that the space just above FLOOR is
+ * kept for whatever grows up from there. */
+void *
+vma_find_free (const struct rb_tree *tree, size_t length,
+		void *floor, void *ceiling) {
+	uint8_t *top = ceiling;
+	struct rb_node *node;
+
+	for (node = rb_last (tree); ; node = rb_prev (node)) {
+		struct vma *vma = node != NULL ? rb_entry (node, struct vma, node) : NULL;
+		uint8_t *bottom = floor;
+
+		if (vma != NULL && (uint8_t *) vma->start >= top)
+			continue;
+		if (vma != NULL && (uint8_t *) vma->end > bottom)
+			bottom = vma->end;
+		if (bottom <= top && (size_t) (top - bottom) >= length)
+			return top - length;
+		if (vma == NULL || bottom == floor)
+			return NULL;
+		top = vma->start;
+	}
+}
+
+/* Creates the page of VMA at VA in the current process's
+ * supplemental page table, and returns it, or a null pointer if
+ * memory is exhausted.  An anonymous page with nothing to read
+ * from the file is left zero-fill, and a page of a shared mapping
+ * reads nothing since it maps the page cache. */
+struct page *
+vma_get_page (struct vma *vma, void *va) {
+	size_t ofs;
+	vm_initializer *init = NULL;
+
+	va = pg_round_down (va);
+	ASSERT (va >= vma->start && va < vma->end);
+
+	ofs = (uint8_t *) va - (uint8_t *) vma->start;
+	if (IS_SHARED (vma->type))
+		init = vma_init_page;
+	else if (VM_TYPE (vma->type) == VM_FILE
+			|| vma_page_file_bytes (vma, ofs) > 0)
+		init = vma_load_page;
+	return vma_new_page (vma, va, init);
+}
+
+/* Maps the pages around ADDR in VMA, which has just faulted on
+ * ADDR's page, that come from the area's file, have not been
+ * created yet, and are recently used in the page cache.  If the
+ * area is advised MADV_SEQUENTIAL, reads in and maps those ahead of
+ * it instead, cached or not. */
+void
+vma_fault_around (struct vma *vma, void *addr) {
+	uint8_t *start, *end;
+	bool recent = vma->advice != MADV_SEQUENTIAL;
+
+	if (vma->file == NULL || vma->advice == MADV_RANDOM)
+		return;
+	if (vma->advice == MADV_SEQUENTIAL) {
+		start = pg_round_down (addr);
+		end = start + SEQ_AHEAD_PAGES * PGSIZE;
+		vma_drop_behind (vma, start);
+	} else {
+		start = (uint8_t *) ROUND_DOWN ((uint64_t) addr,
+				FAULT_AROUND_PAGES * PGSIZE);
+		end = start + FAULT_AROUND_PAGES * PGSIZE;
+	}
+	vma_prefetch (vma, start, end, recent);
+}
+
+/* Makes every page of VMA resident, reading the parts that come
+ * from its file in batches.  This is best effort: pages are left
+ * to be faulted in as usual once memory runs short. */
+void
+vma_populate (struct vma *vma) {
+	uint8_t *va;
+
+	vma_prefetch (vma, vma->start, vma->end, false);
+	for (va = vma->start; va < (uint8_t *) vma->end; va += PGSIZE) {
+		if (palloc_free_count (PAL_USER) <= FAULT_AROUND_PAGES)
+			break;
+		if (spt_find_page (&thread_current ()->spt, va) == NULL)
+			vm_claim_page (va);
+	}
+}
+
+/* Do the madvise.  Gives ADVICE, one of the MADV_* values of
+ * <mman.h>, for the LENGTH bytes at ADDR, which must be
+ * page-aligned and all mapped.  Returns 0 if successful, -1
+ * otherwise. */
+int
+do_madvise (void *addr, size_t length, int advice) {
+	struct rb_tree *vmas = &thread_current ()->vmas;
+	uint8_t *start = addr, *end, *va;
+	struct vma *vma;
+
+	if (pg_ofs (addr) || advice < MADV_NORMAL || advice > MADV_DONTNEED
+			|| !is_user_vaddr (addr) || length > KERN_BASE - (uint64_t) addr)
+		return -1;
+	end = start + ROUND_UP (length, PGSIZE);
+
+	/* The whole range must be mapped. */
+	for (va = start; va < end; va = vma->end)
+		if ((vma = vma_find (vmas, va)) == NULL)
+			return -1;
+
+	for (va = start; va < end; va = vma->end) {
+		uint8_t *from = va;
+		uint8_t *to;
+
+		vma = vma_find (vmas, va);
+		to = end < (uint8_t *) vma->end ? end : vma->end;
+		if (advice == MADV_DONTNEED)
+			vma_discard (vma, from, to);
+		else if (advice == MADV_WILLNEED) {
+			size_t ofs = from - (uint8_t *) vma->start;
+			size_t bytes = to - from;
+
+			/* Only the part that comes from the file has anything to
+			 * read. */
+			if (ofs < vma->file_bytes) {
+				if (bytes > vma->file_bytes - ofs)
+					bytes = vma->file_bytes - ofs;
+				lock_acquire (&filesys_lock);
+				page_cache_prefetch (file_get_inode (vma->file),
+						vma->offset + ofs, bytes);
+				lock_release (&filesys_lock);
+			}
+		} else
+			vma->advice = advice;
+	}
+	return 0;
+}
+
+/* Removes VMA from TREE, the current process's address space,
+ * destroying every page created in it, after writing back the
+ * dirty ones of a file mapping to the page cache, and closing its
+ * file. */
+void
+vma_destroy (struct rb_tree *tree, struct vma *vma) {
+	struct hash *spt = &thread_current ()->spt;
+
+	vma_sync (vma, vma->start, vma->end, false);
+	while (!list_empty (&vma->pages)) {
+		struct page *page = list_entry (list_pop_front (&vma->pages),
+				struct page, vma_elem);
+		spt_remove_page (spt, page);
+	}
+	rb_remove (tree, &vma->node);
+	if (vma->file != NULL) {
+		lock_acquire (&filesys_lock);
+		file_close (vma->file);
+		lock_release (&filesys_lock);
+	}
+	free (vma);
+}
+
+/* Copies every area of SRC into DST, which must be empty, each
+ * with its own reference to its file but no pages.  Returns false
+ * if memory is exhausted, leaving DST partly copied for
+ * vma_kill(). */
+bool
+vma_copy (struct rb_tree *dst, const struct rb_tree *src) {
+	struct rb_node *node;
+
+	for (node = rb_first (src); node != NULL; node = rb_next (node)) {
+		struct vma *vma = rb_entry (node, struct vma, node);
+		struct vma *copy;
+		struct file *file = NULL;
+
+		if (vma->file != NULL) {
+			lock_acquire (&filesys_lock);
+			file = file_reopen (vma->file);
+			lock_release (&filesys_lock);
+			if (file == NULL)
+				return false;
+		}
+		copy = vma_create (dst, vma->start,
+				(uint8_t *) vma->end - (uint8_t *) vma->start, vma->type,
+				vma->writable, file, vma->offset, vma->file_bytes);
+		if (copy == NULL) {
+			lock_acquire (&filesys_lock);
+			file_close (file);
+			lock_release (&filesys_lock);
+			return false;
+		}
+		copy->mmap = vma->mmap;
+		copy->advice = vma->advice;
+	}
+	return true;
+}
+
+/* Removes every area of TREE, the current process's address
+ * space, with their pages, as vma_destroy() does. */
+void
+vma_kill (struct rb_tree *tree) {
+	struct rb_node *node;
+
+	while ((node = rb_first (tree)) != NULL)
+		vma_destroy (tree, rb_entry (node, struct vma, node));
+}
+
+/* Writes back the pages of VMA between START and END that have
+ * been written to since they were last written back, if VMA is a
+ * writable file mapping, to the page cache, and from there to disk
+ * if WAIT.  Runs of consecutive dirty pages are written with one
+ * batched write each. */
+void
+vma_sync (struct vma *vma, void *start, void *end, bool wait) {
+	struct page **sorted;
+	struct page *run[VM_CLAIM_MAX];
+	struct frame *frames[VM_CLAIM_MAX];
+	struct list_elem *e;
+	size_t cnt = 0, i, n = 0;
+
+	if (VM_TYPE (vma->type) != VM_FILE || !vma->writable)
+		return;
+
+	/* Only pages that were created can be dirty.  Sort them by
+	 * address to find the runs. */
+	sorted = malloc (list_size (&vma->pages) * sizeof *sorted);
+	for (e = list_begin (&vma->pages); e != list_end (&vma->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, vma_elem);
+
+		if (page->va < start || page->va >= end
+				|| page->operations->type != VM_FILE)
+			continue;
+		if (sorted == NULL) {
+			/* Out of memory: write the pages one by one. */
+			frames[0] = vm_frame_pin (page);
+			if (frames[0] != NULL && vm_frame_test_and_clean (frames[0]))
+				vma_write_run (vma, &page, frames, 1);
+			else if (frames[0] != NULL)
+				vm_frame_unpin (frames[0]);
+			continue;
+		}
+		sorted[cnt++] = page;
+	}
+	/* Without SORTED the pages are already written and CNT is 0,
+	 * but the cache may still have to go to disk below. */
+	if (sorted != NULL)
+		qsort (sorted, cnt, sizeof *sorted, vma_page_cmp);
+
+	for (i = 0; i < cnt; i++) {
+		struct page *page = sorted[i];
+		struct frame *frame = vm_frame_pin (page);
+
+		if (frame != NULL && !vm_frame_test_and_clean (frame)) {
+			vm_frame_unpin (frame);
+			frame = NULL;
+		}
+		/* A run ends at a clean or non-resident page, a gap, the
+		 * end of the file, or VM_CLAIM_MAX pages. */
+		if (n > 0 && (frame == NULL || n == VM_CLAIM_MAX
+					|| (uint8_t *) run[n - 1]->va + PGSIZE != page->va
+					|| run[n - 1]->file.length < PGSIZE)) {
+			vma_write_run (vma, run, frames, n);
+			n = 0;
+		}
+		if (frame != NULL) {
+			run[n] = page;
+			frames[n++] = frame;
+		}
+	}
+	if (n > 0)
+		vma_write_run (vma, run, frames, n);
+	free (sorted);
+	if (wait)
+		vma_sync_file (vma, start, end);
+}
+
+/* Writes the file's cached pages behind the part of VMA between
+ * START and END out to disk. */
+static void
+vma_sync_file (struct vma *vma, void *start, void *end) {
+	size_t ofs = (uint8_t *) start - (uint8_t *) vma->start;
+	size_t bytes = (uint8_t *) end - (uint8_t *) start;
+
+	if (ofs < vma->file_bytes)
+		page_cache_sync (file_get_inode (vma->file), vma->offset + ofs,
+				vma->file_bytes - ofs < bytes ? vma->file_bytes - ofs : bytes);
+}
+
+/* Lets the evictor take the frames of the SEQ_AHEAD_PAGES pages of
+ * VMA that end SEQ_AHEAD_PAGES before VA first, as a sequential scan
+ * has gone past them. */
+static void
+vma_drop_behind (struct vma *vma, void *va) {
+	struct hash *spt = &thread_current ()->spt;
+	size_t ofs = (uint8_t *) va - (uint8_t *) vma->start;
+	size_t window = SEQ_AHEAD_PAGES * PGSIZE;
+	uint8_t *start, *end, *p;
+
+	if (ofs < window)
+		return;
+	end = (uint8_t *) va - window;
+	start = ofs < 2 * window ? (uint8_t *) vma->start : end - window;
+	for (p = start; p < end; p += PGSIZE) {
+		struct page *page = spt_find_page (spt, p);
+
+		if (page != NULL)
+			vm_frame_deactivate (page);
+	}
+}
+
+/* Destroys the pages of VMA between START and END, after writing
+ * back the dirty ones of a file mapping, freeing their frames and
+ * swap slots.  The next touch creates them afresh, from zeros or
+ * the area's file. */
+static void
+vma_discard (struct vma *vma, void *start, void *end) {
+	struct hash *spt = &thread_current ()->spt;
+	struct list_elem *e;
+
+	vma_sync (vma, start, end, false);
+	for (e = list_begin (&vma->pages); e != list_end (&vma->pages); ) {
+		struct page *page = list_entry (e, struct page, vma_elem);
+
+		e = list_next (e);
+		if (page->va >= start && page->va < end) {
+			list_remove (&page->vma_elem);
+			spt_remove_page (spt, page);
+		}
+	}
+}
+
+/* Orders areas by address. */
+static bool
+vma_less (const struct rb_node *a, const struct rb_node *b,
+		void *aux UNUSED) {
+	return rb_entry (a, struct vma, node)->start
+		< rb_entry (b, struct vma, node)->start;
+}
+
+/* Returns how many bytes of the page at offset OFS into VMA come
+ * from its file. */
+static size_t
+vma_page_file_bytes (const struct vma *vma, size_t ofs) {
+	if (vma->file == NULL || ofs >= vma->file_bytes)
+		return 0;
+	return vma->file_bytes - ofs < PGSIZE ? vma->file_bytes - ofs : PGSIZE;
+}
+
+/* Creates the page of VMA at VA, which must be page-aligned, with
+ * initializer INIT. */
+static struct page *
+vma_new_page (struct vma *vma, void *va, vm_initializer *init) {
+	struct page *page;
+
+	if (!vm_alloc_page_with_initializer (vma->type, va, vma->writable,
+				init, vma))
+		return NULL;
+	page = spt_find_page (&thread_current ()->spt, va);
+	page->vma = vma;
+	list_push_back (&vma->pages, &page->vma_elem);
+	return page;
+}
+
+/* Reads in the pages of VMA between START and END that come from
+ * its file and have not been created, each run of consecutive ones
+ * with one batched read.  If RECENT, only those page_cache_recent()
+ * says are recently used in the cache, which costs no I/O. */
+static void
+vma_prefetch (struct vma *vma, void *start_, void *end_, bool recent) {
+	struct hash *spt = &thread_current ()->spt;
+	uint8_t *start = start_, *end = end_;
+	uint8_t *file_end;
+	uint8_t *va, *run = NULL;
+
+	if (vma->file == NULL)
+		return;
+	/* Only pages with something to read are worth it; zero pages
+	 * cost nothing to fault in. */
+	file_end = (uint8_t *) vma->start + ROUND_UP (vma->file_bytes, PGSIZE);
+	if (start < (uint8_t *) vma->start)
+		start = vma->start;
+	if (end > file_end)
+		end = file_end;
+
+	if (IS_SHARED (vma->type)) {
+		/* The cache reads ahead; just map what it has. */
+		for (va = start; va < end; va += PGSIZE)
+			if (spt_find_page (spt, va) == NULL
+					&& (!recent || vma_page_recent (vma, va))) {
+				if (!vm_frames_plentiful (1))
+					break;
+				vm_claim_page (va);
+			}
+		return;
+	}
+	for (va = start; va < end; va += PGSIZE) {
+		bool missing = spt_find_page (spt, va) == NULL
+			&& (!recent || vma_page_recent (vma, va));
+
+		if (missing && run == NULL)
+			run = va;
+		if (run != NULL && (!missing || va - run == VM_CLAIM_MAX * PGSIZE)) {
+			vma_read_run (vma, run, (va - run) / PGSIZE);
+			run = missing ? va : NULL;
+		}
+	}
+	if (run != NULL)
+		vma_read_run (vma, run, (end - run) / PGSIZE);
+}
+
+/* Returns true if the page cache holds the file page behind VA of
+ * VMA and it has been used lately. */
+static bool
+vma_page_recent (struct vma *vma, void *va) {
+	off_t ofs = (uint8_t *) va - (uint8_t *) vma->start;
+
+	return page_cache_recent (file_get_inode (vma->file), vma->offset + ofs);
+}
+
+/* Creates the CNT pages of VMA from START on, none of which exist
+ * yet, and reads them from the area's file with one batched read.
+ * If that fails, the pages are removed again, to be faulted in
+ * one by one. */
+static void
+vma_read_run (struct vma *vma, void *start, size_t cnt) {
+	struct page *pages[VM_CLAIM_MAX];
+	size_t ofs = (uint8_t *) start - (uint8_t *) vma->start;
+	struct vma_run run;
+	size_t i, n = 0;
+
+	ASSERT (cnt <= VM_CLAIM_MAX);
+
+	for (i = 0; i < cnt; i++) {
+		pages[n] = vma_new_page (vma, (uint8_t *) start + i * PGSIZE,
+				vma_init_page);
+		if (pages[n] == NULL)
+			break;
+		n++;
+	}
+	run.vma = vma;
+	run.offset = vma->offset + ofs;
+	run.bytes = vma->file_bytes - ofs < n * PGSIZE
+		? vma->file_bytes - ofs : n * PGSIZE;
+	if (n > 0)
+		vm_claim_pages (pages, n, vma_fill, &run);
+
+	/* Pages left uninitialized would not know to read their data. */
+	for (i = 0; i < n; i++)
+		if (pages[i]->operations->type == VM_UNINIT) {
+			list_remove (&pages[i]->vma_elem);
+			spt_remove_page (&thread_current ()->spt, pages[i]);
+		}
+}
+
+/* Reads the run AUX, a struct vma_run, into the CNT frames at
+ * KVAS.  Not under filesys_lock: the page cache synchronizes on
+ * frame_lock and sleeps on the disk without it, as kworkerd's
+ * prefetches do, so faults on different files read in parallel. */
+static bool
+vma_fill (void *const kvas[], size_t cnt, void *aux) {
+	struct vma_run *run = aux;
+	off_t read;
+
+	read = file_read_pages_at (run->vma->file, kvas, cnt, run->bytes,
+			run->offset);
+	return read == (off_t) run->bytes;
+}
+
+/* Writes the CNT consecutive pages in PAGES of VMA, held in FRAMES,
+ * pinned, to the area's file with one batched write, and unpins
+ * the frames. */
+static void
+vma_write_run (struct vma *vma, struct page *pages[],
+		struct frame *frames[], size_t cnt) {
+	bool held = lock_held_by_current_thread (&filesys_lock);
+	void *kvas[VM_CLAIM_MAX];
+	size_t i;
+
+	for (i = 0; i < cnt; i++)
+		kvas[i] = frames[i]->kva;
+	if (!held)
+		lock_acquire (&filesys_lock);
+	file_write_pages_at (vma->file, kvas, cnt,
+			(cnt - 1) * PGSIZE + pages[cnt - 1]->file.length,
+			pages[0]->file.offset);
+	if (!held)
+		lock_release (&filesys_lock);
+	for (i = 0; i < cnt; i++)
+		vm_frame_unpin (frames[i]);
+}
+
+/* Orders pointers to pages by address, for qsort(). */
+static int
+vma_page_cmp (const void *a_, const void *b_) {
+	const struct page *a = *(struct page *const *) a_;
+	const struct page *b = *(struct page *const *) b_;
+
+	return a->va < b->va ? -1 : a->va > b->va;
+}
+
+/* Sets up PAGE, a page of area AUX, whose contents are already in
+ * its frame. */
+static bool
+vma_init_page (struct page *page, void *aux) {
+	struct vma *vma = aux;
+	size_t ofs = (uint8_t *) page->va - (uint8_t *) vma->start;
+
+	if (VM_TYPE (vma->type) == VM_FILE) {
+		page->file.file = vma->file;
+		page->file.offset = vma->offset + ofs;
+		page->file.length = vma_page_file_bytes (vma, ofs);
+	}
+	return true;
+}
+
+/* Loads PAGE, a page of area AUX, from the area's file on its
+ * first fault.  The frame is already zeroed. */
+static bool
+vma_load_page (struct page *page, void *aux) {
+	struct vma *vma = aux;
+	size_t ofs = (uint8_t *) page->va - (uint8_t *) vma->start;
+	size_t bytes = vma_page_file_bytes (vma, ofs);
+	off_t read;
+
+	vma_init_page (page, aux);
+	if (bytes == 0)
+		return true;
+
+	// 읽기 전용 page일 수 있으므로 kva로 읽음 (vma_fill처럼 filesys_lock 없이)
+	read = file_read_at (vma->file, page->frame->kva, bytes, vma->offset + ofs);
+	return read == (off_t) bytes;
+}
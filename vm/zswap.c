@@ -0,0 +1,329 @@
+/* zswap.c: Compressed in-memory cache in front of the swap disk.
+ *
+ * An anonymous page on its way to swap is first compressed with a
+ * small LZ77 codec and, if it shrinks to half a page or less, kept
+ * in kernel memory under its swap slot number instead of being
+ * written to disk.  The slot is still allocated on disk, so swap
+ * accounting and slot sharing work as before, but its sectors hold
+ * nothing.  Pages that compress poorly, and pages evicted while the
+ * pool is at its size limit, go to disk as usual.
+ *
+ * Compressed pages live in malloc() blocks, which come out of the
+ * kernel pool.  The pool is capped at ZSWAP_MAX_PAGES worth of
+ * bytes, and nothing is stored while the kernel pool itself runs
+ * low. */
+
+#include "vm/zswap.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Most kernel memory, in pages, that compressed pages may use. */
+#define ZSWAP_MAX_PAGES 256
+
+/* Stop storing once fewer kernel pages than this are free. */
+#define ZSWAP_KERNEL_RESERVE 64
+
+/* A page must compress to at most this many bytes to be kept. */
+#define ZSWAP_MAX_LEN (PGSIZE / 2)
+
+/* A compressed page. */
+struct zswap_entry {
+	uint16_t len;               /* Bytes of DATA. */
+	uint8_t data[];             /* Compressed contents. */
+};
+
+static struct lock zswap_lock;
+static struct zswap_entry **zswap_slots;    /* Indexed by swap slot. */
+static size_t zswap_slot_cnt;
+static size_t zswap_bytes;                  /* Bytes of entries. */
+
+/* Statistics. */
+static long long stored_cnt;        /* Pages kept compressed. */
+static long long loaded_cnt;        /* Pages decompressed. */
+static long long poor_cnt;          /* Pages that did not shrink enough. */
+static long long full_cnt;          /* Pages refused for lack of room. */
+
+/* Codec state, protected by zswap_lock. */
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 10
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+static uint8_t lz_buf[ZSWAP_MAX_LEN];
+
+static size_t lz_compress (const uint8_t *src, size_t size,
+		uint8_t *dst, size_t cap);
+static bool lz_decompress (const uint8_t *src, size_t len,
+		uint8_t *dst, size_t size);
+
+/* Initializes zswap for a swap area of SLOTS slots. */
+void
+zswap_init (size_t slots) {
+	lock_init (&zswap_lock);
+	zswap_slots = calloc (slots, sizeof *zswap_slots);
+	if (zswap_slots == NULL)
+		PANIC ("zswap_init: cannot allocate slot table");
+	zswap_slot_cnt = slots;
+}
+
+/* Tries to keep the page at KVA compressed in memory as the
+ * contents of swap slot SLOT.  Returns true if successful, false
+ * if the page has to go to disk instead. */
+bool
+zswap_store (size_t slot, const void *kva) {
+	struct zswap_entry *entry = NULL;
+	size_t len;
+
+	ASSERT (slot < zswap_slot_cnt);
+
+	lock_acquire (&zswap_lock);
+	ASSERT (zswap_slots[slot] == NULL);
+	if (zswap_bytes + sizeof *entry + ZSWAP_MAX_LEN
+				> (size_t) ZSWAP_MAX_PAGES * PGSIZE
+			|| palloc_free_count (0) < ZSWAP_KERNEL_RESERVE) {
+		full_cnt++;
+		goto done;
+	}
+	len = lz_compress (kva, PGSIZE, lz_buf, sizeof lz_buf);
+	if (len == 0) {
+		poor_cnt++;
+		goto done;
+	}
+	entry = malloc (sizeof *entry + len);
+	if (entry == NULL) {
+		full_cnt++;
+		goto done;
+	}
+	entry->len = len;
+	memcpy (entry->data, lz_buf, len);
+	zswap_slots[slot] = entry;
+	zswap_bytes += sizeof *entry + len;
+	stored_cnt++;
+
+done:
+	lock_release (&zswap_lock);
+	return entry != NULL;
+}
+
+/* If swap slot SLOT is kept compressed, decompresses it into the
+ * page at KVA and returns true.  Otherwise returns false.  The
+ * compressed copy stays until zswap_invalidate(), since other pages
+ * may share the slot. */
+bool
+zswap_load (size_t slot, void *kva) {
+	struct zswap_entry *entry;
+
+	ASSERT (slot < zswap_slot_cnt);
+
+	lock_acquire (&zswap_lock);
+	entry = zswap_slots[slot];
+	if (entry != NULL) {
+		if (!lz_decompress (entry->data, entry->len, kva, PGSIZE))
+			PANIC ("zswap_load: slot %zu is corrupt", slot);
+		loaded_cnt++;
+	}
+	lock_release (&zswap_lock);
+	return entry != NULL;
+}
+
+/* Returns true if swap slot SLOT is kept compressed. */
+bool
+zswap_contains (size_t slot) {
+	bool found;
+
+	ASSERT (slot < zswap_slot_cnt);
+
+	lock_acquire (&zswap_lock);
+	found = zswap_slots[slot] != NULL;
+	lock_release (&zswap_lock);
+	return found;
+}
+
+/* Frees the compressed copy of swap slot SLOT, if any.  Called when
+ * the slot is freed. */
+void
+zswap_invalidate (size_t slot) {
+	struct zswap_entry *entry;
+
+	ASSERT (slot < zswap_slot_cnt);
+
+	lock_acquire (&zswap_lock);
+	entry = zswap_slots[slot];
+	if (entry != NULL) {
+		zswap_slots[slot] = NULL;
+		zswap_bytes -= sizeof *entry + entry->len;
+		free (entry);
+	}
+	lock_release (&zswap_lock);
+}
+
+/* Prints zswap statistics. */
+void
+zswap_print_stats (void) {
+	printf ("zswap: %lld stored, %lld loaded, %lld incompressible, "
+			"%lld refused, %zu bytes in use\n",
+			stored_cnt, loaded_cnt, poor_cnt, full_cnt, zswap_bytes);
+}
+
+/* The codec is LZ77 with an LZ4-like encoding.  The output is a
+ * series of sequences, each a token byte, literals, and a match:
+ *
+ *   - The token's high nibble is the literal count and its low
+ *     nibble the match length minus LZ_MIN_MATCH.  A nibble of 15
+ *     is followed by bytes to add to it, up to and including the
+ *     first that is not 255.
+ *
+ *   - The literals are copied to the output as is.
+ *
+ *   - The match is a 2-byte little-endian offset back into the
+ *     output, from which the match length of bytes is copied.  The
+ *     last sequence stops after its literals and has no match.
+ *
+ * Matches are found through a hash table of the last position at
+ * which each 4-byte string was seen, which is fast and does well
+ * on the zero-filled and repetitive pages that dominate swap. */
+
+/* Returns the hash table index for the 4 bytes at P. */
+static unsigned
+lz_hash (const uint8_t *p) {
+	uint32_t v;
+
+	memcpy (&v, p, sizeof v);
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Appends the extra length bytes for length LEN, whose nibble was
+ * 15, to DST at *OP.  Returns false if that would pass CAP. */
+static bool
+lz_put_len (uint8_t *dst, size_t *op, size_t cap, size_t len) {
+	for (; len >= 255; len -= 255) {
+		if (*op >= cap)
+			return false;
+		dst[(*op)++] = 255;
+	}
+	if (*op >= cap)
+		return false;
+	dst[(*op)++] = len;
+	return true;
+}
+
+/* Appends one sequence to DST at *OP: the LIT_LEN literals at LIT,
+ * then, if MATCH_LEN is nonzero, a match of MATCH_LEN bytes at
+ * OFFSET back.  Returns false if that would pass CAP. */
+static bool
+lz_put_seq (uint8_t *dst, size_t *op, size_t cap, const uint8_t *lit,
+		size_t lit_len, size_t offset, size_t match_len) {
+	size_t m = match_len > 0 ? match_len - LZ_MIN_MATCH : 0;
+	uint8_t *token;
+
+	if (*op >= cap)
+		return false;
+	token = &dst[(*op)++];
+	*token = (lit_len < 15 ? lit_len : 15) << 4 | (m < 15 ? m : 15);
+	if (lit_len >= 15 && !lz_put_len (dst, op, cap, lit_len - 15))
+		return false;
+	if (lit_len > cap - *op)
+		return false;
+	memcpy (dst + *op, lit, lit_len);
+	*op += lit_len;
+	if (match_len == 0)
+		return true;
+	if (cap - *op < 2)
+		return false;
+	dst[(*op)++] = offset & 0xff;
+	dst[(*op)++] = offset >> 8;
+	return m < 15 || lz_put_len (dst, op, cap, m - 15);
+}
+
+/* Compresses the SIZE bytes at SRC, at most 64 kB, into DST, which
+ * has room for CAP bytes.  Returns the compressed length, or 0 if
+ * it would not fit in CAP bytes. */
+static size_t
+lz_compress (const uint8_t *src, size_t size, uint8_t *dst, size_t cap) {
+	size_t ip = 0, anchor = 0, op = 0;
+
+	ASSERT (size <= 0x10000);
+
+	memset (lz_table, 0, sizeof lz_table);
+	while (ip + LZ_MIN_MATCH <= size) {
+		unsigned h = lz_hash (src + ip);
+		size_t cand = lz_table[h];
+		size_t len;
+
+		lz_table[h] = ip;
+		if (cand >= ip || memcmp (src + cand, src + ip, LZ_MIN_MATCH)) {
+			ip++;
+			continue;
+		}
+		/* The match may run into the bytes it produces, which is
+		 * how a run of one byte value comes out. */
+		for (len = LZ_MIN_MATCH; ip + len < size && src[cand + len] == src[ip + len];
+				len++)
+			continue;
+		if (!lz_put_seq (dst, &op, cap, src + anchor, ip - anchor,
+					ip - cand, len))
+			return 0;
+		ip += len;
+		anchor = ip;
+	}
+	if (!lz_put_seq (dst, &op, cap, src + anchor, size - anchor, 0, 0))
+		return 0;
+	return op;
+}
+
+/* Reads an extended length from SRC at *IP, adding it to *LEN.
+ * Returns false if SRC's LEN bytes run out first. */
+static bool
+lz_get_len (const uint8_t *src, size_t len, size_t *ip, size_t *out) {
+	uint8_t b;
+
+	do {
+		if (*ip >= len)
+			return false;
+		b = src[(*ip)++];
+		*out += b;
+	} while (b == 255);
+	return true;
+}
+
+/* Decompresses the LEN bytes at SRC into DST, which must come out
+ * to exactly SIZE bytes.  Returns false if SRC is malformed. */
+static bool
+lz_decompress (const uint8_t *src, size_t len, uint8_t *dst, size_t size) {
+	size_t ip = 0, op = 0;
+
+	while (ip < len) {
+		uint8_t token = src[ip++];
+		size_t lit_len = token >> 4;
+		size_t match_len = token & 15;
+		size_t offset;
+
+		if (lit_len == 15 && !lz_get_len (src, len, &ip, &lit_len))
+			return false;
+		if (lit_len > len - ip || lit_len > size - op)
+			return false;
+		memcpy (dst + op, src + ip, lit_len);
+		ip += lit_len;
+		op += lit_len;
+		if (ip == len)
+			break;
+
+		if (len - ip < 2)
+			return false;
+		offset = src[ip] | src[ip + 1] << 8;
+		ip += 2;
+		if (match_len == 15 && !lz_get_len (src, len, &ip, &match_len))
+			return false;
+		match_len += LZ_MIN_MATCH;
+		if (offset == 0 || offset > op || match_len > size - op)
+			return false;
+		/* Byte by byte, since the match may overlap its output. */
+		for (; match_len > 0; match_len--, op++)
+			dst[op] = dst[op - offset];
+	}
+	return op == size;
+}